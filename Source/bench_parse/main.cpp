@@ -0,0 +1,170 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+#include <standard.hpp>
+#endif
+
+#include <cstdlib>
+#include <new>
+
+import standard;
+import types;
+import common;
+import utf8;
+import latency;
+
+// Microbenchmark of chat message parsing and the string helpers around it
+// runs each operation over corpora of realistic and adversarial chat lines
+// usage: bench_parse [--iterations N] [--filter corpus]
+
+// Heap allocations are counted through replaced global operator new
+std::atomic<std::uint64_t> allocation_count = 0;
+
+auto operator new(const std::size_t size) -> void * {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	if (auto *ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+auto operator new[](const std::size_t size) -> void * { return operator new(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+struct Corpus {
+	std::string_view name;
+	std::vector<std::string> lines;
+};
+
+auto make_corpora() -> std::vector<Corpus> {
+	std::vector<Corpus> corpora;
+	corpora.push_back({"chat",
+					   {"hello chat", "LUL that was close", "@streamer how long are you live?",
+						"PogChamp PogChamp PogChamp", "gg", "first time here, love the stream"}});
+	corpora.push_back({"command",
+					   {"!cc hello there", "!cc <pitch=1.5> woo",
+						"!cc <pitch=0.8,sfx=echo|reverb,pos=1|0|-1> hello <vfx=wave|rainbow> world",
+						"!cc <intensity=5,speed=0.5,offset=-0.5> slow and strong",
+						"!tts <voice=2> read this out loud please"}});
+
+	// Close to the 500 character limit of Twitch
+	std::string longText;
+	while (longText.size() < 480) longText += "lorem ipsum dolor sit amet ";
+	corpora.push_back({"long", {"!cc <pitch=1.2,vfx=wave> " + longText, longText}});
+
+	std::string manyGroups = "!cc";
+	for (int i = 0; i < 48; ++i) manyGroups += std::format(" <pitch={}.5,speed=2> w{}", i % 2, i);
+	corpora.push_back({"many_groups", {manyGroups}});
+
+	corpora.push_back({"unterminated",
+					   {"!cc <pitch=1.5,speed=2 hello", "!cc <<<<<<<<<<<<<<<<",
+						"!cc >>>> <> <,> <=>", "!cc <pitch=1.5> hi <vfx=wave",
+						"!<cc> <a=b=c,=,==,|||> x"}});
+	corpora.push_back({"hostile_values",
+					   {"!cc <pitch=abc|1e999|nan,pos=--1|+|.,speed=inf> x",
+						"!cc <pitch=99999999999999999999999999999999999999999> y",
+						"!cc <pos=1|2|3|4|5|6|7|8|9|10|11|12|13|14|15|16> z"}});
+	corpora.push_back({"multibyte",
+					   {"!cc <vfx=rainbow> héllo wörld ñandú",
+						"!cc 日本語のテキスト <pitch=1.1> です", "🎉🎉🎉 party time 🎉🎉🎉",
+						"!cc <sfx=é|ü> Ünïcödé <vfx=wavé> ëverywhere"}});
+	return corpora;
+}
+
+struct Operation {
+	std::string_view name;
+	std::function<std::size_t(const std::string &)> run; //< Returns something to keep it alive
+};
+
+auto make_operations() -> std::vector<Operation> {
+	const auto submessages = [](const std::string &line) {
+		return TwitchChatMessage("bencher", line).split_into_submessages();
+	};
+	return {
+		{"construct", [](const std::string &line) {
+			 return TwitchChatMessage("bencher", line).get_raw().size();
+		 }},
+		// What the IO thread pays per admitted command: an owned copy of the login, which is
+		// longer than the small string buffer for many logins, the parse and a latency trace
+		{"admit",
+		 [](const std::string &line) {
+			 const auto login = std::string_view("a_fairly_long_twitch_login");
+			 auto msg = TwitchChatMessage(std::string(login), line);
+			 msg.trace = LatencyTracker::new_trace(std::chrono::steady_clock::now());
+			 return msg.get_raw().size() + msg.user.size();
+		 }},
+		{"split", [submessages](const std::string &line) { return submessages(line).size(); }},
+		{"get_message",
+		 [submessages](const std::string &line) {
+			 std::size_t size = 0;
+			 for (const auto &msg : submessages(line)) size += msg.get_message().size();
+			 return size;
+		 }},
+		{"get_command_arg",
+		 [submessages](const std::string &line) {
+			 std::size_t found = 0;
+			 for (const auto &msg : submessages(line)) {
+				 found += msg.get_command_arg<float>(ArgKey::ePitch).has_value();
+				 found += msg.get_command_arg<Position3D>(ArgKey::ePos).has_value();
+				 found += msg.get_command_arg<std::vector<std::string>>(ArgKey::eSfx).has_value();
+				 found += msg.get_command_arg<std::string>("voice").has_value();
+			 }
+			 return found;
+		 }},
+		{"split_string", [](const std::string &line) { return split_string(line, " ").size(); }},
+		{"lowercase", [](const std::string &line) { return lowercase(line).size(); }},
+		{"trim_string", [](const std::string &line) { return trim_string(line).size(); }},
+		{"decode_utf8", [](const std::string &line) { return decode_utf8(line).size(); }},
+	};
+}
+
+auto main(int argc, char **argv) -> int {
+	std::size_t iterations = 2000;
+	std::string_view filter;
+	for (int i = 1; i < argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+		if (arg == "--iterations" && i + 1 < argc) {
+			const auto value = std::string_view(argv[++i]);
+			if (std::from_chars(value.data(), value.data() + value.size(), iterations).ec !=
+					std::errc() ||
+				iterations == 0) {
+				std::println("Invalid iteration count");
+				return 1;
+			}
+		} else if (arg == "--filter" && i + 1 < argc)
+			filter = argv[++i];
+		else {
+			std::println("Usage: {} [--iterations N] [--filter corpus]", argv[0]);
+			return 1;
+		}
+	}
+
+	const auto corpora = make_corpora();
+	const auto operations = make_operations();
+	std::size_t sink = 0;
+
+	std::println("{:<16}{:<16}{:>12}{:>14}", "corpus", "operation", "ns/msg", "allocs/msg");
+	for (const auto &corpus : corpora) {
+		if (!filter.empty() && corpus.name != filter) continue;
+
+		for (const auto &operation : operations) {
+			// Warm up caches and anything lazily initialized
+			for (const auto &line : corpus.lines) sink += operation.run(line);
+
+			const auto allocationsBefore = allocation_count.load(std::memory_order_relaxed);
+			const auto start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < iterations; ++i)
+				for (const auto &line : corpus.lines) sink += operation.run(line);
+			const auto elapsed = std::chrono::steady_clock::now() - start;
+			const auto allocations =
+				allocation_count.load(std::memory_order_relaxed) - allocationsBefore;
+
+			const auto messages = static_cast<double>(iterations * corpus.lines.size());
+			std::println("{:<16}{:<16}{:>12.1f}{:>14.2f}", corpus.name, operation.name,
+						 std::chrono::duration<double, std::nano>(elapsed).count() / messages,
+						 static_cast<double>(allocations) / messages);
+		}
+	}
+
+	// Printed so the work can't be optimized away
+	std::println("checksum {}", sink);
+	return 0;
+}
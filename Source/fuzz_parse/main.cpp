@@ -0,0 +1,90 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+#include <standard.hpp>
+#endif
+
+#include <cstdlib>
+
+import standard;
+import types;
+import common;
+
+// libFuzzer target for chat message parsing, build with clang
+// run: fuzz_parse [corpus dir] [libFuzzer flags], e.g. fuzz_parse -max_len=512
+// any exception escaping, out of bounds read (with sanitizers) or broken invariant is a crash
+
+void check(const bool condition) {
+	if (!condition) std::abort();
+}
+
+// Checks every span and index of parse stays within its tables
+void check_parsed(const ParsedMessage &parsed, const ArgSchema &schema) {
+	const auto within = [&](const TextSpan span) {
+		return std::size_t{span.offset} + span.length <= parsed.source.size();
+	};
+	check(within(parsed.message) && within(parsed.command) && within(parsed.text));
+	check(parsed.numbers.size() == parsed.values.size());
+
+	for (const auto &group : parsed.groups) {
+		check(within(group.text));
+		check(std::size_t{group.firstArg} + group.argCount <= parsed.args.size());
+		for (const auto index : group.knownArgs)
+			check(index == no_arg ||
+				  (index >= group.firstArg && index < group.firstArg + group.argCount));
+	}
+	for (const auto &arg : parsed.args) {
+		check(within(arg.key));
+		check(std::size_t{arg.firstValue} + arg.valueCount <= parsed.values.size());
+		if (arg.known == ArgKey::eCount) continue;
+
+		// Known arguments are accepted by schema, with numbers clamped into range
+		const auto &rule = schema.rule(arg.known);
+		check(rule.accepted);
+		for (const auto &number : parsed.get_numbers(arg))
+			check(!number || (*number >= rule.min && *number <= rule.max));
+	}
+	for (const auto value : parsed.values) check(within(value));
+}
+
+// Runs every accessor over message and its submessages
+void exercise(const TwitchChatMessage &msg) {
+	std::size_t sink = msg.get_raw().size() + msg.get_command().size() + msg.get_args().size();
+	for (const auto &subMsg : msg.split_into_submessages()) {
+		sink += subMsg.get_message().size();
+		sink += subMsg.get_command_arg<float>(ArgKey::ePitch).has_value();
+		sink += subMsg.get_command_arg<std::int32_t>(ArgKey::eOffset).has_value();
+		sink += subMsg.get_command_arg<Position2D>(ArgKey::ePos).has_value();
+		sink += subMsg.get_command_arg<Position3D>(ArgKey::ePos).has_value();
+		sink += subMsg.get_command_arg<std::vector<std::string>>(ArgKey::eVfx).has_value();
+		sink += subMsg.get_command_arg<std::string>("unknown").has_value();
+		sink += subMsg.get_command_arg<bool>("flag").has_value();
+	}
+	check(sink != std::numeric_limits<std::size_t>::max());
+}
+
+extern "C" auto LLVMFuzzerTestOneInput(const std::uint8_t *data, const std::size_t size) -> int {
+	const auto line = std::string_view(reinterpret_cast<const char *>(data), size);
+
+	// Parsed as any chat line, and as a command with a narrow schema
+	const auto defaultSchema = ArgSchema::make_default();
+	const auto narrowSchema =
+		ArgSchema::make_only({{ArgKey::ePitch, std::pair(0.5, 1.5)}, {ArgKey::ePos, std::nullopt}});
+	for (const auto &schema : {defaultSchema, narrowSchema}) {
+		const auto msg = TwitchChatMessage("fuzzer", line, schema);
+		check_parsed(*msg.parsed, schema);
+		check(msg.is_command() == msg.get_raw().starts_with('!'));
+		exercise(msg);
+	}
+
+	// Split into message, command and a single argument as scripts would give them
+	const auto message = line.substr(0, line.find('\0'));
+	const auto rest = line.substr(std::min(line.size(), message.size() + 1));
+	const auto msg =
+		TwitchChatMessage("fuzzer", std::string(message), std::string(rest), {},
+						  {{std::string(rest.substr(0, 8)), {std::string(rest), std::string()}}});
+	check_parsed(*msg.parsed, defaultSchema);
+	exercise(msg);
+
+	// Decoding must reject garbage by value, never by throwing
+	if (const auto number = decode_number<double>(line)) check(std::isfinite(*number));
+	return 0;
+}
@@ -0,0 +1,134 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module admission;
+
+import standard;
+
+// Policy for choosing what to shed once both live slots and the waiting queue are full
+export enum class AdmissionPolicy : std::uint8_t {
+	eDropNewest,	 //< Shed the incoming item
+	eDropOldest,	 //< Shed the item that has waited longest
+	eLowestPriority, //< Shed the lowest priority item, incoming one included
+};
+
+// Snapshot of admission counters
+export struct AdmissionStats {
+	std::size_t cap = 0, active = 0, waiting = 0;
+	std::uint64_t admitted = 0; //< Items started, right away or after waiting
+	std::uint64_t queued = 0;	//< Items that had to wait for a free slot
+	std::uint64_t shed = 0;		//< Items dropped without ever starting
+};
+
+// Gate limiting how many items are live at once, items over the cap wait in a bounded queue
+// each item takes weight slots, e.g. one per OpenAL source it needs
+export template <typename T>
+class AdmissionGate {
+	struct Waiting {
+		T item;
+		std::int32_t priority;
+		std::size_t weight;
+	};
+
+	mutable std::mutex m_mutex;
+	std::deque<Waiting> m_waiting; //< In arrival order
+	std::size_t m_active = 0, m_cap = 1, m_queueLimit = 0;
+	AdmissionPolicy m_policy = AdmissionPolicy::eDropOldest;
+	std::uint64_t m_admitted = 0, m_queued = 0, m_shed = 0;
+
+public:
+	// Sets limits, items already live are let finish even if over the new cap
+	void set_limits(const std::size_t cap, const std::size_t queueLimit,
+					const AdmissionPolicy policy) {
+		std::scoped_lock lock(m_mutex);
+		m_cap = std::max<std::size_t>(cap, 1);
+		m_queueLimit = queueLimit;
+		m_policy = policy;
+		while (m_waiting.size() > m_queueLimit) {
+			m_waiting.pop_front();
+			++m_shed;
+		}
+	}
+
+	// Offers item to the gate
+	// @return the item back if it may start right away, otherwise it was queued or shed
+	auto offer(T item, const std::int32_t priority, std::size_t weight = 1) -> std::optional<T> {
+		std::scoped_lock lock(m_mutex);
+		// Items heavier than the whole cap could never start, let them take all of it instead
+		weight = std::clamp<std::size_t>(weight, 1, m_cap);
+		if (m_waiting.empty() && m_active + weight <= m_cap) {
+			m_active += weight;
+			++m_admitted;
+			return item;
+		}
+
+		if (m_waiting.size() >= m_queueLimit) {
+			switch (m_policy) {
+			case AdmissionPolicy::eDropNewest:
+				++m_shed;
+				return std::nullopt;
+			case AdmissionPolicy::eDropOldest:
+				if (m_waiting.empty()) {
+					++m_shed;
+					return std::nullopt;
+				}
+				m_waiting.pop_front();
+				break;
+			case AdmissionPolicy::eLowestPriority: {
+				// Oldest of the lowest priority goes first, incoming loses ties
+				const auto lowest = std::ranges::min_element(
+					m_waiting, {}, [](const Waiting &waiting) { return waiting.priority; });
+				if (lowest == m_waiting.end() || lowest->priority >= priority) {
+					++m_shed;
+					return std::nullopt;
+				}
+				m_waiting.erase(lowest);
+				break;
+			}
+			}
+			++m_shed;
+		}
+
+		m_waiting.push_back({std::move(item), priority, weight});
+		++m_queued;
+		return std::nullopt;
+	}
+
+	// Frees slots of finished items
+	// @return waiting items which may start now, in the order they should be started
+	auto release(const std::size_t weight = 1) -> std::vector<T> {
+		std::scoped_lock lock(m_mutex);
+		m_active -= std::min(weight, m_active);
+
+		std::vector<T> started;
+		while (!m_waiting.empty()) {
+			// Highest priority first under eLowestPriority, otherwise first come first served
+			// max_element picks the first of equals, keeping arrival order among them
+			auto next = m_waiting.begin();
+			if (m_policy == AdmissionPolicy::eLowestPriority)
+				next = std::ranges::max_element(
+					m_waiting, {}, [](const Waiting &waiting) { return waiting.priority; });
+			if (m_active + next->weight > m_cap) break;
+
+			m_active += next->weight;
+			++m_admitted;
+			started.push_back(std::move(next->item));
+			m_waiting.erase(next);
+		}
+		return started;
+	}
+
+	// Sheds every waiting item, e.g. when everything is being stopped
+	void drop_waiting() {
+		std::scoped_lock lock(m_mutex);
+		m_shed += m_waiting.size();
+		m_waiting.clear();
+	}
+
+	[[nodiscard]] auto get_stats() const -> AdmissionStats {
+		std::scoped_lock lock(m_mutex);
+		return {m_cap, m_active, m_waiting.size(), m_admitted, m_queued, m_shed};
+	}
+};
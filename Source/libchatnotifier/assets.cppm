@@ -8,6 +8,41 @@ export module assets;
 import standard;
 import common;
 import filesystem;
+import trigger;
+import utf8;
+
+// Ascii art read into memory, immutable and shared by every notification showing it
+export struct AsciiArt {
+	std::string text;						   //< Whole art, every line ending in '\n'
+	std::vector<Utf8Line> lines;			   //< Lines of text, decoded once when read
+	std::filesystem::file_time_type writeTime; //< Modification time of the file when read
+
+	AsciiArt(std::string artText, const std::filesystem::file_time_type time)
+		: text(std::move(artText)), lines(decode_utf8_lines(text)), writeTime(time) {}
+	// Lines view into text, so it can't be copied
+	AsciiArt(const AsciiArt &) = delete;
+	auto operator=(const AsciiArt &) -> AsciiArt & = delete;
+};
+
+// Loaded ascii art by key
+using AsciiArtMap = std::map<std::string, std::shared_ptr<const AsciiArt>, std::less<>>;
+
+// Kind of asset a trigger keyword belongs to
+export enum class TriggerKind : std::uint8_t { eAsciiArt, eSound };
+
+// Asset triggered by a keyword in chat
+export struct TriggerAsset {
+	TriggerKind kind;
+	std::string key;
+	std::filesystem::path path;
+	std::shared_ptr<const AsciiArt> art = nullptr; //< Loaded art of ascii art triggers
+};
+
+// Trigger keywords of all assets, keyword i of the matcher belongs to assets[i]
+export struct TriggerSet {
+	std::vector<TriggerAsset> assets;
+	TriggerMatcher matcher;
+};
 
 // Class which handles assets
 export class AssetsHandler {
@@ -17,6 +52,11 @@ export class AssetsHandler {
 	static inline std::map<std::string, std::filesystem::path> ascii_art_files;
 	// Map of easter-egg sounds linked to their paths
 	static inline std::map<std::string, std::filesystem::path> egg_sounds;
+	// Loaded ascii art, replaced whole when assets change so lookups never lock
+	static inline std::atomic<std::shared_ptr<const AsciiArtMap>> ascii_arts;
+	// Trigger keywords of ascii art and easter-egg sounds, replaced whole when assets change
+	// so messages can be matched against it without locking
+	static inline std::atomic<std::shared_ptr<const TriggerSet>> trigger_set;
 
 public:
 	// Method that initializes assets, finds them and populates resources
@@ -24,6 +64,8 @@ public:
 		populate_font_files();
 		populate_ascii_art_files();
 		populate_egg_sounds();
+		load_ascii_arts();
+		build_trigger_set();
 		return Result();
 	}
 
@@ -32,6 +74,8 @@ public:
 		font_files.clear();
 		ascii_art_files.clear();
 		egg_sounds.clear();
+		ascii_arts = nullptr;
+		trigger_set = nullptr;
 	}
 
 	// Finds new assets and populates resources
@@ -39,6 +83,8 @@ public:
 		populate_font_files();
 		populate_ascii_art_files();
 		populate_egg_sounds();
+		load_ascii_arts();
+		build_trigger_set();
 	}
 
 	// Returns path to assets folder
@@ -86,17 +132,18 @@ public:
 	static auto get_ascii_art_path(const std::string &ascii_art_name) -> std::filesystem::path {
 		return ascii_art_files[strip_extension(ascii_art_name)];
 	}
+	// Returns loaded ascii art, nullptr if there's no such art
+	// art is read once and kept until its file changes, see refresh
+	static auto get_ascii_art(const std::string_view ascii_art_name)
+		-> std::shared_ptr<const AsciiArt> {
+		const auto arts = ascii_arts.load();
+		if (!arts) return nullptr;
+		const auto it = arts->find(ascii_art_name.substr(0, ascii_art_name.find('.')));
+		return it != arts->end() ? it->second : nullptr;
+	}
 	// Returns the text data of the ascii art file
 	static auto get_ascii_art_text(const std::string &ascii_art_name) -> std::string {
-		if (const auto &path = get_ascii_art_path(ascii_art_name); std::filesystem::exists(path)) {
-			if (std::ifstream file(path); file.is_open()) {
-				std::string ascii_art;
-				std::string line;
-				while (std::getline(file, line)) ascii_art += line + '\n';
-
-				return ascii_art;
-			}
-		}
+		if (const auto art = get_ascii_art(ascii_art_name)) return art->text;
 		return "";
 	}
 	// Returns available ascii art keys as a vector
@@ -123,7 +170,59 @@ public:
 		return keys;
 	}
 
+	// Returns current trigger keywords, nullptr before initialize
+	static auto get_trigger_set() -> std::shared_ptr<const TriggerSet> { return trigger_set; }
+
 private:
+	// Reads ascii art files into memory, then publishes them
+	// art whose file has the same modification time as when it was read is kept as is
+	static void load_ascii_arts() {
+		const auto previous = ascii_arts.load();
+		auto arts = std::make_shared<AsciiArtMap>();
+		for (const auto &[key, path] : ascii_art_files) {
+			std::error_code ec;
+			const auto writeTime = std::filesystem::last_write_time(path, ec);
+			if (ec) continue;
+
+			if (previous) {
+				if (const auto it = previous->find(key);
+					it != previous->end() && it->second->writeTime == writeTime) {
+					arts->emplace(key, it->second);
+					continue;
+				}
+			}
+			if (auto art = read_ascii_art(path, writeTime)) arts->emplace(key, std::move(art));
+		}
+		ascii_arts = std::move(arts);
+	}
+
+	static auto read_ascii_art(const std::filesystem::path &path,
+							   const std::filesystem::file_time_type writeTime)
+		-> std::shared_ptr<const AsciiArt> {
+		std::ifstream file(path);
+		if (!file.is_open()) return nullptr;
+
+		std::string text;
+		std::string line;
+		while (std::getline(file, line)) text += line + '\n';
+		return std::make_shared<const AsciiArt>(std::move(text), writeTime);
+	}
+
+	// Builds matcher over ascii art and easter-egg sound keys, then publishes it
+	static void build_trigger_set() {
+		std::vector<TriggerAsset> assets;
+		const auto arts = ascii_arts.load();
+		for (const auto &[key, art] : *arts)
+			assets.emplace_back(TriggerKind::eAsciiArt, key, ascii_art_files[key], art);
+		for (const auto &[key, path] : egg_sounds)
+			assets.emplace_back(TriggerKind::eSound, key, path);
+
+		auto keys = std::ranges::to<std::vector<std::string>>(
+			assets | std::views::transform(&TriggerAsset::key));
+		auto matcher = TriggerMatcher(std::move(keys));
+		trigger_set = std::make_shared<const TriggerSet>(std::move(assets), std::move(matcher));
+	}
+
 	// Method that populates the fonts map
 	static void populate_font_files() {
 		for (const auto &entry : std::filesystem::directory_iterator(get_font_assets_path())) {
@@ -17,6 +17,9 @@ export module audio;
 import standard;
 import config;
 import common;
+import latency;
+import admission;
+import queue;
 
 // Struct of passable (memory) sound data
 export struct SoundData {
@@ -38,82 +41,401 @@ export struct SoundOptions {
 	std::optional<float> offset = std::nullopt;
 	std::optional<Position3D> pos = std::nullopt;
 	std::optional<std::vector<std::string>> effects = std::nullopt;
+	std::shared_ptr<MessageTrace> trace = nullptr; //< Marked once playback starts
+	std::int32_t priority = 0; //< Lower priority sounds are shed first under load
+};
+
+// Decoded sound in an OpenAL buffer, shared by every source playing it
+// buffer is deleted once the last sound playing it and the sound bank let go of it
+struct SoundBuffer {
+	ALuint buffer = 0;
+	float length = 0.0f;   //< Length in seconds
+	std::size_t bytes = 0; //< Size of the decoded samples
+
+	SoundBuffer(const ALuint buffer, const float length, const std::size_t bytes)
+		: buffer(buffer), length(length), bytes(bytes) {}
+	SoundBuffer(const SoundBuffer &) = delete;
+	auto operator=(const SoundBuffer &) -> SoundBuffer & = delete;
+	~SoundBuffer() { alDeleteBuffers(1, &buffer); }
+};
+
+// Auxiliary effect slots feeding one into the next, shared by every sound with the same effects
+// slots are deleted once the last sound using them lets go
+struct EffectChain {
+	std::vector<ALuint> slots; //< In order, sources send to the first one
+
+	explicit EffectChain(std::vector<ALuint> slots) : slots(std::move(slots)) {}
+	EffectChain(const EffectChain &) = delete;
+	auto operator=(const EffectChain &) -> EffectChain & = delete;
+	~EffectChain() {
+		// Slots can't be deleted while targeted, so untarget every one first
+		for (const auto slot : slots)
+			alAuxiliaryEffectSloti(slot, AL_EFFECTSLOT_TARGET_SOFT, AL_EFFECTSLOT_NULL);
+		alDeleteAuxiliaryEffectSlots(static_cast<ALsizei>(slots.size()), slots.data());
+	}
 };
 
 struct AudioPlayerSound {
 	SoundOptions options;
-	ALuint buffer = 0, SID = 0;
-	float length = 0.0f, lengthOffset = 0.0f;
-	std::vector<ALuint> effectSlots;
-	std::chrono::time_point<std::chrono::steady_clock> endedTime;
+	std::shared_ptr<const SoundBuffer> buffer;
+	ALuint SID = 0;
+	std::shared_ptr<const EffectChain> effects = nullptr;
+	std::chrono::time_point<std::chrono::steady_clock> startedTime, endedTime;
 	std::shared_ptr<AudioPlayerSound> next = nullptr;
+	bool admitted = true; //< Holds its admission slot, given back once the sound ends
 
-	explicit AudioPlayerSound(const SoundOptions &opts, const ALuint &buffer, const ALuint &SID,
-							  const float &length)
-		: options(opts), buffer(buffer), SID(SID), length(length) {}
+	explicit AudioPlayerSound(const SoundOptions &opts,
+							  std::shared_ptr<const SoundBuffer> soundBuffer, const ALuint &SID)
+		: options(opts), buffer(std::move(soundBuffer)), SID(SID) {}
 };
 
+// Returns name of OpenAL error
+auto get_al_error_name(const ALenum error) -> std::string_view {
+	switch (error) {
+	case AL_INVALID_NAME:
+		return "AL_INVALID_NAME";
+	case AL_INVALID_ENUM:
+		return "AL_INVALID_ENUM";
+	case AL_INVALID_VALUE:
+		return "AL_INVALID_VALUE";
+	case AL_INVALID_OPERATION:
+		return "AL_INVALID_OPERATION";
+	case AL_OUT_OF_MEMORY:
+		return "AL_OUT_OF_MEMORY";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+// Formats error detail holding an OpenAL error
+auto format_al_error(const std::int64_t error) -> std::string {
+	return std::string(get_al_error_name(static_cast<ALenum>(error)));
+}
+
+// Formats error detail holding a libsndfile error
+auto format_sndfile_error(const std::int64_t error) -> std::string {
+	return sf_error_number(static_cast<int>(error));
+}
+
 // Method for checking and printing out OpenAL errors
 export auto check_al_errors(const std::source_location location = std::source_location::current())
 	-> bool {
 	if (const auto error = alGetError(); error != AL_NO_ERROR) {
-		std::string errorStr;
-		switch (error) {
-		case AL_INVALID_NAME:
-			errorStr = "AL_INVALID_NAME";
-			break;
-		case AL_INVALID_ENUM:
-			errorStr = "AL_INVALID_ENUM";
-			break;
-		case AL_INVALID_VALUE:
-			errorStr = "AL_INVALID_VALUE";
-			break;
-		case AL_INVALID_OPERATION:
-			errorStr = "AL_INVALID_OPERATION";
-			break;
-		case AL_OUT_OF_MEMORY:
-			errorStr = "AL_OUT_OF_MEMORY";
-			break;
-		default:
-			errorStr = "UNKNOWN";
-			break;
-		}
-		std::println("OpenAL Error: {} at {}:{}", errorStr, location.file_name(), location.line());
+		std::println("OpenAL Error: {} at {}:{}", get_al_error_name(error), location.file_name(),
+					 location.line());
 		return true;
 	}
 	return false;
 }
 
+// Decodes sound file into memory
+auto read_sound_file(const std::filesystem::path &file) -> std::expected<SoundData, Error> {
+	// Load file using sndfile
+	SF_INFO sfInfo;
+	const auto sndFile = sf_open(file.string().c_str(), SFM_READ, &sfInfo);
+	if (!sndFile)
+		return fail(ErrorCode::eFileOpen, "Failed to open sound file", sf_error(nullptr),
+					format_sndfile_error);
+
+	std::vector<float> samples(sfInfo.frames * sfInfo.channels);
+	sf_readf_float(sndFile, samples.data(), sfInfo.frames);
+	sf_close(sndFile);
+
+	return SoundData{samples, static_cast<std::uint32_t>(sfInfo.samplerate),
+					 static_cast<std::uint32_t>(sfInfo.channels)};
+}
+
+// Uploads decoded sound into a new OpenAL buffer
+auto create_sound_buffer(const SoundData &soundData)
+	-> std::expected<std::shared_ptr<const SoundBuffer>, Error> {
+	const auto format = soundData.channels == 1 ? AL_FORMAT_MONO_FLOAT32 : AL_FORMAT_STEREO_FLOAT32;
+	const auto dataSize = static_cast<ALsizei>(soundData.data.size() * sizeof(float));
+
+	ALuint buffer;
+	alGenBuffers(1, &buffer);
+	alBufferData(buffer, format, soundData.data.data(), dataSize, soundData.samplerate);
+	if (const auto error = alGetError(); error != AL_NO_ERROR) {
+		alDeleteBuffers(1, &buffer);
+		return fail(ErrorCode::eAudioResource, "Failed to create sound buffer", error,
+					format_al_error);
+	}
+	return std::make_shared<const SoundBuffer>(buffer, soundData.lengthInSeconds,
+											   static_cast<std::size_t>(dataSize));
+}
+
+// Counters of the sound bank
+export struct SoundBankStats {
+	std::size_t sounds = 0, bytes = 0, budget = 0;
+	std::uint64_t hits = 0, misses = 0, evictions = 0;
+};
+
+// Cache of decoded sound files, so triggers replaying a sound don't decode it every time
+// least recently played sounds are evicted once their buffers go over the memory budget
+class SoundBank {
+	struct Entry {
+		std::shared_ptr<const SoundBuffer> buffer;
+		std::filesystem::file_time_type writeTime; //< Of the file when it was decoded
+		std::list<std::string>::iterator recent;   //< Position in m_recent
+	};
+	std::unordered_map<std::string, Entry, TransparentStringHash, std::equal_to<>> m_entries;
+	// Keys of entries, most recently played first
+	std::list<std::string> m_recent;
+	std::size_t m_bytes = 0, m_budget = 0;
+	std::uint64_t m_hits = 0, m_misses = 0, m_evictions = 0;
+	std::mutex m_mutex;
+
+public:
+	// Sets memory budget in bytes, evicting sounds over it
+	void set_budget(const std::size_t budget) {
+		std::scoped_lock lock(m_mutex);
+		m_budget = budget;
+		evict();
+	}
+
+	// Returns buffer of sound file, decoding it if it isn't in the bank
+	auto get(const std::filesystem::path &file)
+		-> std::expected<std::shared_ptr<const SoundBuffer>, Error> {
+		auto key = file.string();
+		{
+			std::scoped_lock lock(m_mutex);
+			if (const auto it = m_entries.find(key); it != m_entries.end()) {
+				++m_hits;
+				m_recent.splice(m_recent.begin(), m_recent, it->second.recent);
+				return it->second.buffer;
+			}
+			++m_misses;
+		}
+
+		// Decoded without holding the lock, so hits aren't held up by it
+		std::error_code ec;
+		const auto writeTime = std::filesystem::last_write_time(file, ec);
+		const auto soundData = read_sound_file(file);
+		if (!soundData) return std::unexpected(soundData.error());
+		auto buffer = create_sound_buffer(*soundData);
+		if (!buffer) return buffer;
+
+		std::scoped_lock lock(m_mutex);
+		// Same file may have been decoded meanwhile, keep the one already in the bank
+		if (const auto it = m_entries.find(key); it != m_entries.end()) return it->second.buffer;
+		m_recent.push_front(key);
+		m_bytes += (*buffer)->bytes;
+		m_entries.emplace(std::move(key), Entry{*buffer, writeTime, m_recent.begin()});
+		evict();
+		return buffer;
+	}
+
+	// Drops sounds whose files have changed or are gone since they were decoded
+	void drop_changed() {
+		std::scoped_lock lock(m_mutex);
+		for (auto it = m_entries.begin(); it != m_entries.end();) {
+			std::error_code ec;
+			if (const auto writeTime = std::filesystem::last_write_time(it->first, ec);
+				!ec && writeTime == it->second.writeTime) {
+				++it;
+				continue;
+			}
+			m_bytes -= it->second.buffer->bytes;
+			m_recent.erase(it->second.recent);
+			it = m_entries.erase(it);
+		}
+	}
+
+	// Drops every sound, buffers of sounds still playing go once those sounds are cleared
+	void clear() {
+		std::scoped_lock lock(m_mutex);
+		m_entries.clear();
+		m_recent.clear();
+		m_bytes = 0;
+	}
+
+	auto get_stats() -> SoundBankStats {
+		std::scoped_lock lock(m_mutex);
+		return {m_entries.size(), m_bytes, m_budget, m_hits, m_misses, m_evictions};
+	}
+
+private:
+	// Evicts least recently played sounds until within budget, m_mutex must be held
+	void evict() {
+		while (m_bytes > m_budget && !m_recent.empty()) {
+			const auto it = m_entries.find(m_recent.back());
+			m_bytes -= it->second.buffer->bytes;
+			m_entries.erase(it);
+			m_recent.pop_back();
+			++m_evictions;
+		}
+	}
+};
+
+// Counters of the source pool
+export struct SourcePoolStats {
+	std::size_t size = 0, inUse = 0, highWater = 0;
+	std::uint64_t acquired = 0;	 //< Sources handed out, stolen ones included
+	std::uint64_t stolen = 0;	 //< Sources taken over from sounds cut short
+	std::uint64_t exhausted = 0; //< Sounds dropped with no source free or worth stealing
+};
+
+// Fixed set of OpenAL sources created up front, recycled between sounds instead of regenerated
+class SourcePool {
+	std::vector<ALuint> m_sources, m_free;
+	std::size_t m_highWater = 0;
+	std::uint64_t m_acquired = 0, m_stolen = 0, m_exhausted = 0;
+	mutable std::mutex m_mutex;
+
+public:
+	// Creates up to count sources, fewer if the device runs out before that
+	void create(const std::size_t count) {
+		std::scoped_lock lock(m_mutex);
+		while (m_sources.size() < count) {
+			ALuint source = 0;
+			alGenSources(1, &source);
+			if (alGetError() != AL_NO_ERROR) break;
+			m_sources.push_back(source);
+		}
+		m_free.assign(m_sources.rbegin(), m_sources.rend());
+	}
+
+	// Deletes every source, none may be in use anymore
+	void destroy() {
+		std::scoped_lock lock(m_mutex);
+		alDeleteSources(static_cast<ALsizei>(m_sources.size()), m_sources.data());
+		m_sources.clear();
+		m_free.clear();
+	}
+
+	[[nodiscard]] auto size() const -> std::size_t {
+		std::scoped_lock lock(m_mutex);
+		return m_sources.size();
+	}
+
+	// Takes free source, if any
+	auto acquire() -> std::optional<ALuint> {
+		std::scoped_lock lock(m_mutex);
+		if (m_free.empty()) return std::nullopt;
+		const auto source = m_free.back();
+		m_free.pop_back();
+		++m_acquired;
+		m_highWater = std::max(m_highWater, m_sources.size() - m_free.size());
+		return source;
+	}
+
+	// Resets stopped source to defaults and gives it back to the pool
+	// rewinding leaves it AL_INITIAL, like a freshly generated source
+	void release(const ALuint source) {
+		alSourceRewind(source);
+		alSourcei(source, AL_BUFFER, 0);
+		alSourcef(source, AL_PITCH, 1.0f);
+		alSourcef(source, AL_GAIN, 1.0f);
+		alSource3f(source, AL_POSITION, 0.0f, 0.0f, 0.0f);
+		alSourcei(source, AL_SOURCE_RELATIVE, AL_FALSE);
+		alSourcei(source, AL_SOURCE_SPATIALIZE_SOFT, AL_AUTO_SOFT);
+		alSourcei(source, AL_DIRECT_CHANNELS_SOFT, AL_FALSE);
+
+		std::scoped_lock lock(m_mutex);
+		m_free.push_back(source);
+	}
+
+	void count_stolen() {
+		std::scoped_lock lock(m_mutex);
+		++m_stolen;
+	}
+
+	void count_exhausted() {
+		std::scoped_lock lock(m_mutex);
+		++m_exhausted;
+	}
+
+	[[nodiscard]] auto get_stats() const -> SourcePoolStats {
+		std::scoped_lock lock(m_mutex);
+		return {m_sources.size(), m_sources.size() - m_free.size(), m_highWater, m_acquired,
+				m_stolen, m_exhausted};
+	}
+};
+
+// Source that stopped playing, as reported by the OpenAL event thread
+struct SourceEvent {
+	ALuint source = 0;
+};
+
+// Upper limit of pooled sources, however many the device would mix
+constexpr std::size_t max_pooled_sources = 256;
+
 // Super-duper simple audio player
 export class AudioPlayer {
 	static inline float m_volume;
 	static inline ALCdevice *m_device = nullptr;
 	static inline ALCcontext *m_context = nullptr;
 	static inline std::map<std::string, ALuint> m_effects;
-
-	// Vector of sounds
-	static inline std::vector<std::shared_ptr<AudioPlayerSound>> m_sounds;
+	// Effect chains by their effect names joined with '|', expired once no sound uses them
+	static inline std::unordered_map<std::string, std::weak_ptr<const EffectChain>,
+									 TransparentStringHash, std::equal_to<>>
+		m_effectChains;
+
+	// Sounds by their source
+	static inline std::unordered_map<ALuint, std::shared_ptr<AudioPlayerSound>> m_sounds;
+	// Ended sounds fading out, in order of ending
+	static inline std::deque<std::shared_ptr<AudioPlayerSound>> m_endedSounds;
+	// Stopped sources from AL_SOFT_events, sources are polled instead without the extension
+	static inline std::unique_ptr<BoundedQueue<SourceEvent>> m_sourceEvents;
+	// Set when the event queue was full, the next update polls every source to catch up
+	static inline std::atomic<bool> m_sourceEventsDropped = false;
+	// Playback waiting for free sources, start returns how many sources it ended up using
+	struct PendingPlayback {
+		std::function<std::size_t()> start;
+		std::size_t sources;
+	};
+	// Caps sources of sounds still playing, sounds over it wait or get shed
+	static inline AdmissionGate<PendingPlayback> m_admission;
+	// Buffers of sound files, memory sounds aren't kept in it
+	static inline SoundBank m_soundBank;
+	// Sources every sound plays from, sized by what the device can mix
+	static inline SourcePool m_sourcePool;
+	// Admission slots of sounds cut short for their sources, given back once playback started
+	static inline std::size_t m_stolenSlots = 0;
+	// Guards sounds and everything tracking them, playback is started from the dispatcher and
+	// Python threads while update runs on the runner thread
+	static inline std::mutex m_playerMutex;
 
 public:
 	static auto initialize() -> Result {
 		// Get primary output device
 		const auto primaryOutput = alcGetString(nullptr, ALC_DEFAULT_DEVICE_SPECIFIER);
-		if (!primaryOutput) return {1, "Failed to get primary audio output"};
+		if (!primaryOutput)
+			return fail(ErrorCode::eAudioDevice, "Failed to get primary audio output");
 
 		// Open audio device and context
 		m_device = alcOpenDevice(primaryOutput);
-		if (!m_device) return {1, "Failed to open audio device"};
+		if (!m_device) return fail(ErrorCode::eAudioDevice, "Failed to open audio device");
 
 		constexpr std::array attrs{ALC_HRTF_SOFT, ALC_TRUE, 0};
 		m_context = alcCreateContext(m_device, attrs.data());
-		if (!m_context) return {1, "Failed to create audio context"};
+		if (!m_context) return fail(ErrorCode::eAudioDevice, "Failed to create audio context");
 
-		if (!alcMakeContextCurrent(m_context)) return {1, "Failed to make audio context current"};
+		if (!alcMakeContextCurrent(m_context))
+			return fail(ErrorCode::eAudioDevice, "Failed to make audio context current");
 		check_al_errors();
 
-		if (!alIsExtensionPresent("AL_EXT_float32")) return {1, "AL_EXT_float32 not supported"};
+		if (!alIsExtensionPresent("AL_EXT_float32"))
+			return fail(ErrorCode::eAudioDevice, "AL_EXT_float32 not supported");
 		check_al_errors();
 
+		// Create sources up front, as many as the device can mix at once
+		ALCint monoSources = 0, stereoSources = 0;
+		alcGetIntegerv(m_device, ALC_MONO_SOURCES, 1, &monoSources);
+		alcGetIntegerv(m_device, ALC_STEREO_SOURCES, 1, &stereoSources);
+		m_sourcePool.create(std::clamp<std::size_t>(
+			std::max(monoSources, 0) + std::max(stereoSources, 0), 1, max_pooled_sources));
+		if (m_sourcePool.size() == 0)
+			return fail(ErrorCode::eAudioDevice, "Failed to create sound sources");
+
+		// Have stopped sources reported instead of polling every one on each update
+		if (alIsExtensionPresent("AL_SOFT_events")) {
+			m_sourceEvents = std::make_unique<BoundedQueue<SourceEvent>>(max_pooled_sources * 4);
+			constexpr std::array<ALenum, 1> events{AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT};
+			alEventControlSOFT(events.size(), events.data(), AL_TRUE);
+			alEventCallbackSOFT(on_al_event, nullptr);
+			check_al_errors();
+		}
+
 		// Default effects //
 
 		// Basic reverb
@@ -210,6 +532,14 @@ public:
 
 	static void cleanup() {
 		stop_sounds();
+		m_soundBank.clear();
+		m_sourcePool.destroy();
+		m_effectChains.clear();
+		if (m_sourceEvents) {
+			// Callback is not running anymore once unset
+			alEventCallbackSOFT(nullptr, nullptr);
+			m_sourceEvents.reset();
+		}
 		for (const auto &effect : m_effects | std::views::values) alDeleteEffects(1, &effect);
 		alcMakeContextCurrent(nullptr);
 		alcDestroyContext(m_context);
@@ -218,68 +548,64 @@ public:
 
 	// Handles uninitializing ended sounds and playing next sound in sequence
 	static void update() {
-		for (const auto sound : m_sounds) {
-			// Play next sound in sequence if current one has reached the point
-			auto soundTime = 0.0f;
-			alGetSourcef(sound->SID, AL_SEC_OFFSET, &soundTime);
-			auto soundState = AL_INITIAL;
-			alGetSourcei(sound->SID, AL_SOURCE_STATE, &soundState);
-
-			if (sound->next != nullptr &&
-				(soundState == AL_STOPPED || soundTime >= sound->length + sound->lengthOffset)) {
-				// Start playback of next sound if next soundstate is AL_INITIAL
-				auto nextSoundState = AL_INITIAL;
-				alGetSourcei(sound->next->SID, AL_SOURCE_STATE, &nextSoundState);
-				if (nextSoundState == AL_INITIAL)
-					alSourcePlay(sound->next->SID);
+		std::scoped_lock lock(m_playerMutex);
+		std::size_t endedSounds = 0;
+		if (m_sourceEvents) {
+			while (const auto event = m_sourceEvents->try_pop()) {
+				// Source may have been recycled since, so event only counts if still stopped
+				const auto it = m_sounds.find(event->source);
+				if (it == m_sounds.end()) continue;
+				auto soundState = AL_INITIAL;
+				alGetSourcei(event->source, AL_SOURCE_STATE, &soundState);
+				if (soundState == AL_STOPPED) endedSounds += end_sound(it->second);
 			}
-		}
+			if (m_sourceEventsDropped.exchange(false)) endedSounds += poll_sounds();
+		} else
+			endedSounds += poll_sounds();
 		check_al_errors();
 
 		// Clean ended sounds, 3s delay from their end to allow effects to fade out
-		std::vector<std::shared_ptr<AudioPlayerSound>> soundsToRemove;
-		for (const auto sound : m_sounds) {
-			auto soundState = AL_INITIAL;
-			alGetSourcei(sound->SID, AL_SOURCE_STATE, &soundState);
-			auto soundTime = 0.0f;
-			alGetSourcef(sound->SID, AL_SEC_OFFSET, &soundTime);
-			check_al_errors();
-			if (soundState != AL_PLAYING && soundState != AL_INITIAL &&
-				soundTime >= sound->length) {
-				if (sound->endedTime.time_since_epoch().count() == 0)
-					sound->endedTime = std::chrono::steady_clock::now();
-				else if (std::chrono::steady_clock::now() - sound->endedTime >=
-						 std::chrono::seconds(3)) {
-					clear_sound_oal(sound);
-					soundsToRemove.push_back(sound);
-				}
+		const auto now = std::chrono::steady_clock::now();
+		while (!m_endedSounds.empty() &&
+			   now - m_endedSounds.front()->endedTime >= std::chrono::seconds(3)) {
+			const auto sound = std::move(m_endedSounds.front());
+			m_endedSounds.pop_front();
+			// Stolen sounds are already gone, and their source may belong to another sound
+			if (const auto it = m_sounds.find(sound->SID);
+				it != m_sounds.end() && it->second == sound) {
+				clear_sound_oal(sound);
+				m_sounds.erase(it);
 			}
 		}
 		check_al_errors();
 
-		// Remove sounds
-		for (const auto sound : soundsToRemove) m_sounds.erase(std::ranges::find(m_sounds, sound));
+		// Let waiting sounds take slots of the ended ones
+		if (endedSounds > 0) release_sources(endedSounds);
 	}
 
 	// Method for clearing out OpenAL sound
 	static void clear_sound_oal(const std::shared_ptr<AudioPlayerSound> &sound) {
 		alSourceStop(sound->SID);
-		// Make effect slots unused first, before deleting them
+		// Detach from effect chain first, it's deleted if this was the last sound using it
 		alSource3i(sound->SID, AL_AUXILIARY_SEND_FILTER, AL_EFFECTSLOT_NULL, 0, AL_FILTER_NULL);
-		for (const auto effectSlot : sound->effectSlots)
-			alAuxiliaryEffectSloti(effectSlot, AL_EFFECTSLOT_TARGET_SOFT, AL_EFFECTSLOT_NULL);
-
-		alDeleteAuxiliaryEffectSlots(sound->effectSlots.size(), sound->effectSlots.data());
-		alDeleteSources(1, &sound->SID);
-		alDeleteBuffers(1, &sound->buffer);
+		sound->effects = nullptr;
+		m_sourcePool.release(sound->SID);
 	}
 
 	// Stops all sounds
 	static void stop_sounds() {
-		for (const auto sound : m_sounds) clear_sound_oal(sound);
+		std::scoped_lock lock(m_playerMutex);
+		std::size_t admitted = 0;
+		for (const auto &sound : m_sounds | std::views::values) {
+			clear_sound_oal(sound);
+			if (sound->admitted) ++admitted;
+		}
 
 		check_al_errors();
+		m_admission.drop_waiting();
+		m_admission.release(admitted);
 		m_sounds.clear();
+		m_endedSounds.clear();
 	}
 
 	static auto get_global_volume() -> float { return m_volume; }
@@ -288,65 +614,29 @@ public:
 		alListenerf(AL_GAIN, m_volume);
 	}
 
-	static auto load_sound_oal(const SoundData &soundData, const SoundOptions &opts)
-		-> std::shared_ptr<AudioPlayerSound> {
-		const auto format =
-			soundData.channels == 1 ? AL_FORMAT_MONO_FLOAT32 : AL_FORMAT_STEREO_FLOAT32;
-		const auto dataSize = static_cast<ALsizei>(soundData.data.size() * sizeof(float));
-
-		// OpenAL sound creation
-		ALuint buffer;
-		alGenBuffers(1, &buffer);
-		alBufferData(buffer, format, soundData.data.data(), dataSize, soundData.samplerate);
-		if (check_al_errors()) {
-			alDeleteBuffers(1, &buffer);
-			return nullptr;
-		}
-
-		// Create sound source
-		ALuint SID;
-		alGenSources(1, &SID);
-		alSourcei(SID, AL_BUFFER, static_cast<ALint>(buffer));
-		if (check_al_errors()) {
-			alDeleteSources(1, &SID);
-			alDeleteBuffers(1, &buffer);
-			return nullptr;
+	static auto load_sound_oal(const std::shared_ptr<const SoundBuffer> &buffer,
+							   const SoundOptions &opts)
+		-> std::expected<std::shared_ptr<AudioPlayerSound>, Error> {
+		// Take sound source from the pool
+		const auto source = acquire_source(opts.priority);
+		if (!source) return fail(ErrorCode::eAudioResource, "No sound source free");
+		const auto SID = *source;
+		alSourcei(SID, AL_BUFFER, static_cast<ALint>(buffer->buffer));
+		if (const auto error = alGetError(); error != AL_NO_ERROR) {
+			m_sourcePool.release(SID);
+			return fail(ErrorCode::eAudioResource, "Failed to set sound source buffer", error,
+						format_al_error);
 		}
 
 		// Create new sound
-		const auto sound =
-			std::make_shared<AudioPlayerSound>(opts, buffer, SID, soundData.lengthInSeconds);
+		const auto sound = std::make_shared<AudioPlayerSound>(opts, buffer, SID);
 
-		// Create effects if given
+		// Send to effect chain if given, first effect passes on to the rest
 		if (opts.effects) {
-			std::vector<ALuint> effectSlots;
-			const auto wantedEffects = opts.effects.value();
-			for (std::uint32_t i = 0; i < wantedEffects.size(); ++i) {
-				if (const auto effect = wantedEffects[i]; m_effects.contains(effect)) {
-					ALuint effectSlot = 0;
-					alGenAuxiliaryEffectSlots(1, &effectSlot);
-					alAuxiliaryEffectSloti(effectSlot, AL_EFFECTSLOT_EFFECT, m_effects[effect]);
-					effectSlots.push_back(effectSlot);
-				}
-			}
-			check_al_errors();
-			sound->effectSlots = effectSlots;
-
-			// Set first effect as aux send
-			if (!effectSlots.empty())
-				alSource3i(SID, AL_AUXILIARY_SEND_FILTER, effectSlots[0], 0, AL_FILTER_NULL);
-
-			check_al_errors();
-
-			// Finally, target every effect to their next effect, or the source if it's the last
-			for (std::uint32_t i = 0; i < effectSlots.size(); ++i) {
-				if (i + 1 < effectSlots.size())
-					alAuxiliaryEffectSloti(effectSlots[i], AL_EFFECTSLOT_TARGET_SOFT,
-										   effectSlots[i + 1]);
-				else
-					alAuxiliaryEffectSloti(effectSlots[i], AL_EFFECTSLOT_TARGET_SOFT,
-										   AL_EFFECTSLOT_NULL);
-			}
+			sound->effects = get_effect_chain(opts.effects.value());
+			if (sound->effects)
+				alSource3i(SID, AL_AUXILIARY_SEND_FILTER,
+						   static_cast<ALint>(sound->effects->slots.front()), 0, AL_FILTER_NULL);
 			check_al_errors();
 		}
 
@@ -371,79 +661,287 @@ public:
 		return sound;
 	}
 
+	// Sounds are decoded on the calling thread, so playback waiting for admission only needs
+	// its ready buffers once sources free up on the update thread
 	static void play_oneshot(const std::filesystem::path &file, const SoundOptions &opts = {}) {
-		// Load file using sndfile
-		SF_INFO sfInfo;
-		const auto sndFile = sf_open(file.string().c_str(), SFM_READ, &sfInfo);
-		if (!sndFile) return;
-
-		std::vector<float> samples(sfInfo.frames * sfInfo.channels);
-		sf_readf_float(sndFile, samples.data(), sfInfo.frames);
-		sf_close(sndFile);
-
-		// Load sound
-		const auto sound = load_sound_oal({samples, static_cast<std::uint32_t>(sfInfo.samplerate),
-										   static_cast<std::uint32_t>(sfInfo.channels)},
-										  opts);
-		m_sounds.push_back(sound);
-		alSourcePlay(sound->SID);
+		if (auto buffer = get_sound_buffer(file))
+			admit_sequence({std::move(*buffer)}, {opts});
+		else
+			print_error(buffer.error());
 	}
 
 	// Plays given sounds in order, waiting for last one to finish before starting next
 	static void play_sequential(const std::vector<std::filesystem::path> &files,
 								const std::vector<SoundOptions> &opts) {
-		std::vector<std::shared_ptr<AudioPlayerSound>> sequence;
+		std::vector<std::shared_ptr<const SoundBuffer>> buffers;
+		std::vector<SoundOptions> soundOpts;
 		for (const auto &[file, opt] : std::views::zip(files, opts)) {
-			// Load file using sndfile
-			SF_INFO sfInfo;
-			const auto sndFile = sf_open(file.string().c_str(), SFM_READ, &sfInfo);
-			if (!sndFile) continue;
+			if (buffers.size() >= max_sequence_length()) break;
+			if (auto buffer = get_sound_buffer(file)) {
+				buffers.push_back(std::move(*buffer));
+				soundOpts.push_back(opt);
+			} else
+				print_error(buffer.error());
+		}
+		admit_sequence(std::move(buffers), std::move(soundOpts));
+	}
 
-			std::vector<float> samples(sfInfo.frames * sfInfo.channels);
-			sf_readf_float(sndFile, samples.data(), sfInfo.frames);
-			sf_close(sndFile);
+	// Plays from memory
+	static void play_oneshot_memory(const SoundData &soundData, const SoundOptions &opts) {
+		if (auto buffer = create_sound_buffer(soundData))
+			admit_sequence({std::move(*buffer)}, {opts});
+		else
+			print_error(buffer.error());
+	}
+
+	// Plays given sounds in order from memory, waiting for last one to finish before starting next
+	static void play_sequential_memory(const std::vector<SoundData> &soundDatas,
+									   const std::vector<SoundOptions> &opts) {
+		std::vector<std::shared_ptr<const SoundBuffer>> buffers;
+		std::vector<SoundOptions> soundOpts;
+		for (const auto &[soundData, opt] : std::views::zip(soundDatas, opts)) {
+			if (buffers.size() >= max_sequence_length()) break;
+			if (auto buffer = create_sound_buffer(soundData)) {
+				buffers.push_back(std::move(*buffer));
+				soundOpts.push_back(opt);
+			} else
+				print_error(buffer.error());
+		}
+		admit_sequence(std::move(buffers), std::move(soundOpts));
+	}
 
-			// Load sound
-			const auto sound =
-				load_sound_oal({samples, static_cast<std::uint32_t>(sfInfo.samplerate),
-								static_cast<std::uint32_t>(sfInfo.channels)},
-							   opt);
+	// Returns counters of sound admission, weighed in sources
+	static auto get_admission_stats() -> AdmissionStats { return m_admission.get_stats(); }
 
-			// Assign next sound in sequence
-			if (!sequence.empty()) sequence.back()->next = sound;
-			sequence.push_back(sound);
+	// Returns counters of the source pool
+	static auto get_source_pool_stats() -> SourcePoolStats { return m_sourcePool.get_stats(); }
+
+	// Returns counters of the sound bank
+	static auto get_sound_bank_stats() -> SoundBankStats { return m_soundBank.get_stats(); }
+
+	// Drops sound files changed on disk from the sound bank, they're decoded again on next play
+	static void refresh_sounds() { m_soundBank.drop_changed(); }
+
+private:
+	// Starts playback through admission, sources is how many it will need at most
+	static void admit(const std::size_t sources, const std::int32_t priority,
+					  std::function<std::size_t()> start) {
+		m_admission.set_limits(global_config.maxSoundSources.value,
+							   global_config.admissionQueue.value, global_config.admissionPolicy);
+		if (const auto admitted =
+				m_admission.offer({std::move(start), sources}, priority, sources)) {
+			std::scoped_lock lock(m_playerMutex);
+			start_admitted(*admitted);
 		}
+	}
 
-		// Add to sounds
-		m_sounds.insert(m_sounds.end(), sequence.begin(), sequence.end());
+	// Runs admitted playback, handing back sources it didn't end up needing
+	// along with slots of sounds it cut short to get sources
+	static void start_admitted(const PendingPlayback &playback) {
+		const auto used = std::min(playback.start(), playback.sources);
+		if (const auto unused = playback.sources - used + std::exchange(m_stolenSlots, 0);
+			unused > 0)
+			release_sources(unused);
+	}
 
-		// Begin playback of first sound
-		alSourcePlay(sequence.front()->SID);
+	// Returns effect chain of given effects, creating it if no sound uses it yet
+	// unknown effects are skipped, nullptr if none are left
+	static auto get_effect_chain(const std::vector<std::string> &effects)
+		-> std::shared_ptr<const EffectChain> {
+		std::string key;
+		std::vector<ALuint> chainEffects;
+		for (const auto &effect : effects) {
+			if (const auto it = m_effects.find(effect); it != m_effects.end()) {
+				if (!key.empty()) key += '|';
+				key += effect;
+				chainEffects.push_back(it->second);
+			}
+		}
+		if (chainEffects.empty()) return nullptr;
+		if (const auto it = m_effectChains.find(key); it != m_effectChains.end())
+			if (auto chain = it->second.lock()) return chain;
+
+		// Forget chains deleted since the last one was created
+		std::erase_if(m_effectChains, [](const auto &entry) { return entry.second.expired(); });
+
+		std::vector<ALuint> slots(chainEffects.size());
+		alGenAuxiliaryEffectSlots(static_cast<ALsizei>(slots.size()), slots.data());
+		if (check_al_errors()) return nullptr;
+
+		// Target every effect to their next effect, or the output if it's the last
+		for (std::size_t i = 0; i < slots.size(); ++i) {
+			alAuxiliaryEffectSloti(slots[i], AL_EFFECTSLOT_EFFECT,
+								   static_cast<ALint>(chainEffects[i]));
+			alAuxiliaryEffectSloti(slots[i], AL_EFFECTSLOT_TARGET_SOFT,
+								   i + 1 < slots.size() ? static_cast<ALint>(slots[i + 1])
+														: AL_EFFECTSLOT_NULL);
+		}
+		check_al_errors();
+
+		auto chain = std::make_shared<const EffectChain>(std::move(slots));
+		m_effectChains.insert_or_assign(std::move(key), chain);
+		return chain;
 	}
 
-	// Plays from memory, returns sound length in milliseconds
-	static void play_oneshot_memory(const SoundData &soundData, const SoundOptions &opts) {
-		const auto sound = load_sound_oal(soundData, opts);
-		m_sounds.push_back(sound);
-		alSourcePlay(sound->SID);
+	// Takes source from the pool, stealing one from another sound if none are free
+	static auto acquire_source(const std::int32_t priority) -> std::optional<ALuint> {
+		if (const auto source = m_sourcePool.acquire()) return source;
+		if (!steal_source(priority)) {
+			m_sourcePool.count_exhausted();
+			return std::nullopt;
+		}
+		m_sourcePool.count_stolen();
+		return m_sourcePool.acquire();
 	}
 
-	// Plays given sounds in order from memory, waiting for last one to finish before starting next
-	static void play_sequential_memory(const std::vector<SoundData> &soundDatas,
-									   const std::vector<SoundOptions> &opts) {
+	// Called on the OpenAL event thread, which must not call into OpenAL itself
+	static void AL_APIENTRY on_al_event(const ALenum eventType, const ALuint object,
+										const ALuint param, ALsizei, const ALchar *,
+										void *) noexcept {
+		if (eventType != AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT || param != AL_STOPPED) return;
+		if (!m_sourceEvents->try_push({object})) m_sourceEventsDropped = true;
+	}
+
+	// Checks state of every sound, for when stops aren't reported as events
+	// @return how many sounds ended
+	static auto poll_sounds() -> std::size_t {
+		std::size_t endedSounds = 0;
+		for (const auto &sound : m_sounds | std::views::values) {
+			auto soundState = AL_INITIAL;
+			alGetSourcei(sound->SID, AL_SOURCE_STATE, &soundState);
+			if (soundState == AL_STOPPED) endedSounds += end_sound(sound);
+		}
+		return endedSounds;
+	}
+
+	// Marks stopped sound as ended and starts next sound in its sequence
+	// fading out only needs the source, which can be stolen if another sound needs it,
+	// so the admission slot goes to waiting sounds right away
+	// @return 1 if the sound gave its admission slot back, 0 if it had ended already
+	static auto end_sound(const std::shared_ptr<AudioPlayerSound> &sound) -> std::size_t {
+		if (sound->endedTime.time_since_epoch().count() != 0) return 0;
+		sound->endedTime = std::chrono::steady_clock::now();
+		sound->admitted = false;
+		m_endedSounds.push_back(sound);
+
+		// Start playback of next sound if it's still waiting for its turn
+		if (sound->next != nullptr) {
+			auto nextSoundState = AL_INITIAL;
+			alGetSourcei(sound->next->SID, AL_SOURCE_STATE, &nextSoundState);
+			if (nextSoundState == AL_INITIAL) {
+				alSourcePlay(sound->next->SID);
+				sound->next->startedTime = sound->endedTime;
+			}
+			// Sequence has moved on, stealing this sound while it fades must not cut the rest
+			sound->next = nullptr;
+		}
+		return 1;
+	}
+
+	// Cuts a sound short to free its source, along with the rest of its sequence
+	// sounds fading out go first, their sequence has moved on without them, then lowest
+	// priority and oldest playing, never higher priority ones, sounds still waiting for their
+	// turn in a sequence go after playing ones as cutting them would cut the rest of it too
+	static auto steal_source(const std::int32_t priority) -> bool {
+		const auto sounds = m_sounds | std::views::values;
+		const auto victim = std::ranges::min_element(
+			sounds, {}, [](const std::shared_ptr<AudioPlayerSound> &sound) {
+				const auto waiting = sound->startedTime.time_since_epoch().count() == 0;
+				return std::tuple(sound->admitted, sound->options.priority, waiting,
+								  sound->startedTime);
+			});
+		if (victim == sounds.end() ||
+			((*victim)->admitted && (*victim)->options.priority > priority))
+			return false;
+
+		// Earlier sound in the sequence must not go on to start it
+		const auto stolen = *victim;
+		for (const auto &sound : sounds)
+			if (sound->next == stolen) sound->next = nullptr;
+
+		for (auto sound = stolen; sound != nullptr; sound = sound->next) {
+			clear_sound_oal(sound);
+			if (sound->admitted) ++m_stolenSlots;
+			m_sounds.erase(sound->SID);
+		}
+		return true;
+	}
+
+	// Frees sources of removed sounds, starting playbacks that were waiting for them
+	static void release_sources(const std::size_t sources) {
+		for (const auto &playback : m_admission.release(sources)) start_admitted(playback);
+	}
+
+	// Returns buffer of sound file from the sound bank
+	static auto get_sound_buffer(const std::filesystem::path &file)
+		-> std::expected<std::shared_ptr<const SoundBuffer>, Error> {
+		m_soundBank.set_budget(std::size_t{global_config.soundBankBudget.value} << 20);
+		return m_soundBank.get(file);
+	}
+
+	// Longest sequence admission can charge for in full, longer ones are cut to it
+	static auto max_sequence_length() -> std::size_t {
+		return std::max<std::size_t>(global_config.maxSoundSources.value, 1);
+	}
+
+	// Admits sequence of ready buffers, charged one source per sound
+	static void admit_sequence(std::vector<std::shared_ptr<const SoundBuffer>> buffers,
+							   std::vector<SoundOptions> opts) {
+		if (buffers.empty()) return;
+		const auto sources = buffers.size();
+		const auto priority = opts.front().priority;
+		admit(sources, priority, [buffers = std::move(buffers), opts = std::move(opts)] {
+			return buffers.size() == 1 ? start_oneshot_buffer(buffers.front(), opts.front())
+									   : start_sequential_buffers(buffers, opts);
+		});
+	}
+
+	static auto start_oneshot_buffer(const std::shared_ptr<const SoundBuffer> &buffer,
+									 const SoundOptions &opts) -> std::size_t {
+		const auto sound = load_sound_oal(buffer, opts);
+		if (!sound) {
+			print_error(sound.error());
+			return 0;
+		}
+		m_sounds.emplace((*sound)->SID, *sound);
+		start_playback(**sound);
+		return 1;
+	}
+
+	static auto
+	start_sequential_buffers(const std::vector<std::shared_ptr<const SoundBuffer>> &buffers,
+							 const std::vector<SoundOptions> &opts) -> std::size_t {
 		std::vector<std::shared_ptr<AudioPlayerSound>> sequence;
-		for (const auto &[soundData, opt] : std::views::zip(soundDatas, opts)) {
-			const auto sound = load_sound_oal(soundData, opt);
+		for (const auto &[buffer, opt] : std::views::zip(buffers, opts)) {
+			const auto sound = load_sound_oal(buffer, opt);
+			if (!sound) {
+				print_error(sound.error());
+				continue;
+			}
 
 			// Assign next sound in sequence
-			if (!sequence.empty()) sequence.back()->next = sound;
-			sequence.push_back(sound);
+			if (!sequence.empty()) sequence.back()->next = *sound;
+			sequence.push_back(*sound);
 		}
+		if (sequence.empty()) return 0;
 
 		// Add to sounds
-		m_sounds.insert(m_sounds.end(), sequence.begin(), sequence.end());
+		for (const auto &sound : sequence) m_sounds.emplace(sound->SID, sound);
 
 		// Begin playback of first sound
-		alSourcePlay(sequence.front()->SID);
+		start_playback(*sequence.front());
+		return sequence.size();
+	}
+
+	// Sounds fail on the playback path, where there's no caller to hand errors to
+	static void print_error(const Error &error) {
+		std::println("Audio error: {}", error.describe());
+	}
+
+	// Starts playing sound, marking the latency trace it belongs to
+	static void start_playback(AudioPlayerSound &sound) {
+		alSourcePlay(sound.SID);
+		sound.startedTime = std::chrono::steady_clock::now();
+		if (sound.options.trace) sound.options.trace->mark(LatencyStage::eAudioStart);
 	}
 };
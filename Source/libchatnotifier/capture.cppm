@@ -0,0 +1,81 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module capture;
+
+import standard;
+import common;
+
+// Capture files are a magic header followed by records of
+// [u64 nanoseconds since capture start][u32 frame length][frame bytes]
+// integers are stored little-endian, which is native on every platform we build for
+static_assert(std::endian::native == std::endian::little);
+constexpr std::array<char, 8> capture_magic = {'C', 'N', 'C', 'A', 'P', '0', '0', '1'};
+
+// Single captured frame
+export struct CaptureFrame {
+	std::chrono::nanoseconds offset; //< Time since capture start
+	std::string data;
+};
+
+// Class for appending raw frames into a capture file
+export class CaptureWriter {
+	std::ofstream m_file;
+	std::chrono::time_point<std::chrono::steady_clock> m_start;
+
+public:
+	auto open(const std::filesystem::path &path) -> Result {
+		m_file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+		if (!m_file.is_open()) return fail(ErrorCode::eFileOpen, "Failed to open capture file");
+
+		m_file.write(capture_magic.data(), capture_magic.size());
+		m_start = std::chrono::steady_clock::now();
+		return Result();
+	}
+
+	void close() { m_file.close(); }
+
+	[[nodiscard]] auto is_open() const -> bool { return m_file.is_open(); }
+
+	void write(const std::string_view frame,
+			   const std::chrono::time_point<std::chrono::steady_clock> received) {
+		const std::uint64_t offset =
+			std::chrono::duration_cast<std::chrono::nanoseconds>(received - m_start).count();
+		const auto length = static_cast<std::uint32_t>(frame.size());
+		m_file.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+		m_file.write(reinterpret_cast<const char *>(&length), sizeof(length));
+		m_file.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+	}
+};
+
+// Class for reading frames back from a capture file
+export class CaptureReader {
+	std::ifstream m_file;
+
+public:
+	auto open(const std::filesystem::path &path) -> Result {
+		m_file = std::ifstream(path, std::ios::binary);
+		if (!m_file.is_open()) return fail(ErrorCode::eFileOpen, "Failed to open capture file");
+
+		std::array<char, capture_magic.size()> magic{};
+		if (!m_file.read(magic.data(), magic.size()) || magic != capture_magic)
+			return fail(ErrorCode::eFileFormat, "Not a capture file");
+
+		return Result();
+	}
+
+	// Returns next frame, or nullopt at the end of file (or a truncated record)
+	auto next() -> std::optional<CaptureFrame> {
+		std::uint64_t offset = 0;
+		std::uint32_t length = 0;
+		if (!m_file.read(reinterpret_cast<char *>(&offset), sizeof(offset)) ||
+			!m_file.read(reinterpret_cast<char *>(&length), sizeof(length)))
+			return std::nullopt;
+
+		CaptureFrame frame{std::chrono::nanoseconds(offset), std::string(length, '\0')};
+		if (!m_file.read(frame.data.data(), length)) return std::nullopt;
+		return frame;
+	}
+};
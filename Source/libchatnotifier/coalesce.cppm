@@ -0,0 +1,113 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module coalesce;
+
+import standard;
+import config;
+
+// Counter of copies folded into a message, shared with the notification showing it
+export using RepeatCounter = std::shared_ptr<std::atomic<std::uint32_t>>;
+
+// Snapshot of coalescer counters
+export struct CoalesceStats {
+	std::size_t groups = 0;		//< Distinct messages within the window
+	std::uint64_t absorbed = 0; //< Duplicates folded into an earlier message
+};
+
+// Returns hash of command and message, ignoring case and repeated/surrounding whitespace
+// FNV-1a over the normalized bytes, without building the normalized string
+export constexpr auto hash_normalized_message(const std::string_view command,
+											  const std::string_view message) -> std::uint64_t {
+	std::uint64_t hash = 14695981039346656037ull;
+	const auto add = [&hash](const char ch) {
+		hash ^= static_cast<std::uint8_t>(ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch);
+		hash *= 1099511628211ull;
+	};
+	const auto is_space = [](const char ch) {
+		return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+	};
+
+	for (const auto ch : command) add(ch);
+	add('\0');
+
+	bool pendingSpace = false, started = false;
+	for (const auto ch : message) {
+		if (is_space(ch)) {
+			pendingSpace = started;
+			continue;
+		}
+		if (pendingSpace) add(' ');
+		add(ch);
+		pendingSpace = false;
+		started = true;
+	}
+	return hash;
+}
+
+// Class for folding identical commands sent within a short window into one notification
+// meant to be used from a single thread, the dispatcher thread
+export class CommandCoalescer {
+	struct Group {
+		std::chrono::time_point<std::chrono::steady_clock> start;
+		std::uint32_t passed = 0; //< Copies let through individually
+		RepeatCounter repeats;	  //< Counter of the last copy let through
+	};
+
+	static inline std::unordered_map<std::uint64_t, Group> m_groups;
+	static inline std::chrono::time_point<std::chrono::steady_clock> m_lastPrune;
+	static inline std::atomic<std::uint64_t> m_absorbed = 0;
+	static inline std::atomic<std::size_t> m_groupCount = 0;
+
+public:
+	// Decides whether message should run, or be folded into an earlier copy of it
+	// @return counter to attach to message, or nullptr if it was absorbed
+	static auto admit(const std::string_view command, const std::string_view message,
+					  const std::chrono::time_point<std::chrono::steady_clock> now)
+		-> RepeatCounter {
+		const auto window = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<float>(global_config.coalesceWindow.value));
+		if (window <= std::chrono::steady_clock::duration::zero())
+			return std::make_shared<std::atomic<std::uint32_t>>(1);
+
+		prune(now, window);
+
+		auto &group = m_groups[hash_normalized_message(command, message)];
+		m_groupCount = m_groups.size();
+		if (!group.repeats || now - group.start >= window) group = {now, 0, nullptr};
+
+		if (group.passed < global_config.coalesceThreshold.value) {
+			++group.passed;
+			group.repeats = std::make_shared<std::atomic<std::uint32_t>>(1);
+			return group.repeats;
+		}
+
+		group.repeats->fetch_add(1, std::memory_order_relaxed);
+		m_absorbed.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	static auto get_stats() -> CoalesceStats {
+		return {m_groupCount.load(std::memory_order_relaxed),
+				m_absorbed.load(std::memory_order_relaxed)};
+	}
+
+	static void reset() {
+		m_groups.clear();
+		m_groupCount = 0;
+		m_absorbed = 0;
+	}
+
+private:
+	// Drops groups whose window has passed, at most once per window
+	static void prune(const std::chrono::time_point<std::chrono::steady_clock> now,
+					  const std::chrono::steady_clock::duration window) {
+		if (now - m_lastPrune < window) return;
+		m_lastPrune = now;
+		std::erase_if(m_groups,
+					  [&](const auto &entry) { return now - entry.second.start >= window; });
+		m_groupCount = m_groups.size();
+	}
+};
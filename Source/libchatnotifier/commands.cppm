@@ -11,9 +11,15 @@ import config;
 import common;
 import assets;
 import audio;
+import latency;
+import coalesce;
+import trigger;
 
 // Command function using
 using CommandFunction = std::function<void(const TwitchChatMessage &)>;
+// Launches notification of text, shown under ascii art if it's given
+export using LaunchNotification = std::function<void(
+	const std::string &, const TwitchChatMessage &, const std::shared_ptr<const AsciiArt> &)>;
 
 // Struct for command
 export struct Command {
@@ -21,74 +27,106 @@ export struct Command {
 	std::string callstr, description;
 	CommandFunction func;
 	float transitionTime = 0.0f;
-	std::chrono::time_point<std::chrono::steady_clock> lastExecuted;
+	std::uint32_t id = 0; //< Interned ID, assigned by CommandHandler
+	std::int32_t priority = 0; //< Notifications and sounds of lower priority are shed first
+	ArgSchema schema = ArgSchema::make_default(); //< Arguments accepted, applied when parsing
 
 	Command() = default;
 	Command(std::string call, std::string desc, const CommandFunction &f)
 		: enabled(true), callstr(std::move(call)), description(std::move(desc)), func(f) {}
 };
 
+// What the dispatcher thread needs to run a command, copied out of the commands map
+struct CommandExecution {
+	CommandFunction func;
+	bool enabled = false;
+	std::int32_t priority = 0;
+};
+
+// Lookups done on the chat threads, rebuilt and published whole whenever commands change
+struct CommandIndex {
+	// Lowercase call string to command ID
+	std::unordered_map<std::string, std::uint32_t, TransparentStringHash, std::equal_to<>>
+		callIds;
+	std::vector<std::string> idKeys; //< Command ID to key
+	std::vector<ArgSchema> schemas;	 //< Command ID to its argument schema
+	std::vector<CommandExecution> executions; //< Command ID to how it's executed
+};
+
 // Class for commands handling
 export class CommandHandler {
-	static inline std::map<std::string, Command> m_commandsMap;
+	static inline std::map<std::string, Command, std::less<>> m_commandsMap;
+	// Command ID to key, IDs are kept for as long as the handler lives
+	static inline std::vector<std::string> m_idKeys;
+	// Snapshot for the chat threads, which never see it change under them
+	static inline std::atomic<std::shared_ptr<const CommandIndex>> m_index;
+	// Guards changes to the commands, which come from script refreshes and the GUI
+	static inline std::mutex m_commandsMutex;
+	// Command ID to time it was last executed, kept apart so executing never touches the map
+	static inline std::vector<std::chrono::time_point<std::chrono::steady_clock>> m_lastExecuted;
+	static inline std::mutex m_lastExecutedMutex;
 
 public:
 	// Initializes CommandHandler, adding the default commands
 	// requires passing the method for launching notifications, circular dependency stuff..
-	static auto initialize(const std::function<void(const std::string &, const TwitchChatMessage &)>
-							   &launch_notification) -> Result {
+	static auto initialize(const LaunchNotification &launch_notification) -> Result {
 		if (m_commandsMap.empty()) {
-			m_commandsMap["custom_notification"] = Command(
+			auto customNotification = Command(
 				"cc", "Custom Notification",
 				[launch_notification](const TwitchChatMessage &mainMsg) {
 					for (auto splitMsgs = mainMsg.split_into_submessages(); auto &msg : splitMsgs) {
-						std::string notifMsg = msg.get_message();
-						if (notifMsg.empty()) return;
-
-						// Split to words (space-separated)
-						const auto words = split_string(notifMsg, " ");
-
-						// Get the first ascii art from words and prepend it to the notification
-						const auto asciiarts = AssetsHandler::get_ascii_art_keys();
-						for (const auto &word : words) {
-							if (const auto found = std::ranges::find(asciiarts, word);
-								found != asciiarts.end()) {
-								notifMsg =
-									AssetsHandler::get_ascii_art_text(*found) + "\n" + notifMsg;
-								break;
-							}
-						}
+						const auto message = msg.get_message();
+						if (message.empty()) return;
 
-						auto audioPitch = msg.get_command_arg<float>("pitch").value_or(1.0f);
-						audioPitch = std::clamp(audioPitch, 0.1f, 2.0f);
+						const auto audioPitch =
+							msg.get_command_arg<float>(ArgKey::ePitch).value_or(1.0f);
+						const auto audioOffset =
+							msg.get_command_arg<float>(ArgKey::eOffset)
+								.value_or(global_config.audioSequenceOffset.value);
 
-						auto audioOffset = msg.get_command_arg<float>("offset").value_or(
-							global_config.audioSequenceOffset.value);
-
-						const auto audioPos = msg.get_command_arg<Position3D>("pos");
+						const auto audioPos = msg.get_command_arg<Position3D>(ArgKey::ePos);
 						const auto audioEffects =
-							msg.get_command_arg<std::vector<std::string>>("sfx");
+							msg.get_command_arg<std::vector<std::string>>(ArgKey::eSfx);
 
-						// Find all easter egg sound words, pushing into vector
-						// limited to global_config.maxAudioTriggers
+						// Find ascii art and easter egg sound words in one pass over the message
+						// first ascii art is shown above the notification, sounds are limited to
+						// global_config.maxAudioTriggers
+						std::shared_ptr<const AsciiArt> asciiArt;
 						std::vector<std::filesystem::path> sounds;
 						std::vector<SoundOptions> soundOptions;
-						const auto eggSounds = AssetsHandler::get_egg_sound_keys();
-						for (const auto &word : words) {
-							if (const auto found = std::ranges::find(eggSounds, word);
-								found != eggSounds.end() &&
-								sounds.size() < global_config.maxAudioTriggers.value) {
-								sounds.emplace_back(AssetsHandler::get_egg_sound_path(*found));
+						const auto triggers = AssetsHandler::get_trigger_set();
+						const auto matches =
+							triggers ? triggers->matcher.find_all(
+										   message, {global_config.triggerIgnoreCase, true})
+									 : std::vector<TriggerMatch>{};
+						for (const auto &match : matches) {
+							const auto &asset = triggers->assets[match.pattern];
+							if (asset.kind == TriggerKind::eAsciiArt) {
+								if (!asciiArt) asciiArt = asset.art;
+							} else if (asset.kind == TriggerKind::eSound &&
+									   sounds.size() < global_config.maxAudioTriggers.value) {
+								sounds.emplace_back(asset.path);
 								soundOptions.emplace_back(1.0f, audioPitch, audioOffset, audioPos,
-														  audioEffects);
+														  audioEffects, msg.trace, msg.priority);
 							}
 						}
+
 						// Play easter egg sounds
 						if (!sounds.empty()) AudioPlayer::play_sequential(sounds, soundOptions);
 
-						launch_notification(notifMsg, msg);
+						launch_notification(message, msg, asciiArt);
 					}
 				});
+			// Every known argument, within the default ranges
+			customNotification.schema = ArgSchema::make_only(
+				{{ArgKey::ePitch, std::nullopt},
+				 {ArgKey::eOffset, std::nullopt},
+				 {ArgKey::ePos, std::nullopt},
+				 {ArgKey::eSfx, std::nullopt},
+				 {ArgKey::eVfx, std::nullopt},
+				 {ArgKey::eIntensity, std::nullopt},
+				 {ArgKey::eSpeed, std::nullopt}});
+			add_command("custom_notification", customNotification);
 		}
 
 		return Result();
@@ -96,63 +134,172 @@ public:
 
 	// Cleans up resources used by CommandHandler
 	static void cleanup() {
+		std::scoped_lock lock(m_commandsMutex, m_lastExecutedMutex);
 		m_commandsMap.clear();
+		m_idKeys.clear();
+		m_lastExecuted.clear();
+		m_index = nullptr;
 	}
 
-	// Returns key for command with given call string
-	static auto get_command_key(const std::string &call) -> std::string {
+	// Returns key for command with given call string, view is valid until the command is removed
+	static auto get_command_key(const std::string_view call) -> std::string_view {
 		for (const auto &[key, cmd] : m_commandsMap)
 			if (cmd.callstr == call) return key;
 
 		return "";
 	}
 
+	// Returns ID of command with given call string, matched case-insensitively
+	static auto find_command_id(const std::string_view call) -> std::optional<std::uint32_t> {
+		// Lowercase into a stack buffer, calls longer than it can't match anyway
+		std::array<char, 64> lowerBuf;
+		if (call.size() > lowerBuf.size()) return std::nullopt;
+		std::ranges::transform(call, lowerBuf.begin(), [](const char ch) {
+			return static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+		});
+
+		const auto index = m_index.load();
+		if (!index) return std::nullopt;
+		const auto it = index->callIds.find(std::string_view(lowerBuf.data(), call.size()));
+		if (it == index->callIds.end()) return std::nullopt;
+		return it->second;
+	}
+
+	// Returns argument schema of command with given ID, the default one if there's no such command
+	static auto get_arg_schema(const std::optional<std::uint32_t> id) -> ArgSchema {
+		if (const auto index = m_index.load(); index && id && *id < index->schemas.size())
+			return index->schemas[*id];
+		return ArgSchema::make_default();
+	}
+
+	// Returns key of command with given ID, copied as commands may change meanwhile
+	static auto get_command_key(const std::uint32_t id) -> std::string {
+		if (const auto index = m_index.load(); index && id < index->idKeys.size())
+			return index->idKeys[id];
+		return {};
+	}
+
 	// Returns a non-modifiable command map
-	static auto get_commands_map() -> const std::map<std::string, Command> & {
+	static auto get_commands_map() -> const std::map<std::string, Command, std::less<>> & {
 		return m_commandsMap;
 	}
 
 	// Sets whether command is enabled
 	static void set_command_enabled(const std::string &key, const bool enabled) {
+		std::scoped_lock lock(m_commandsMutex);
 		// If the key does not exist, skip
 		if (!m_commandsMap.contains(key)) return;
 		m_commandsMap[key].enabled = enabled;
+		publish_index();
 	}
 
 	// Method for changing the call string of a command
 	static void change_command_call(const std::string &key, const std::string &newCall) {
+		std::scoped_lock lock(m_commandsMutex);
 		// If the key does not exist, skip
 		if (!m_commandsMap.contains(key)) return;
 		// Make sure the new call is not empty
 		if (newCall.empty()) return;
 		// Change the callstr
 		m_commandsMap[key].callstr = newCall;
+		publish_index();
 	}
 
 	// Method for executing a command
-	static void execute_command(const std::string &key, const TwitchChatMessage &msg) {
+	static void execute_command(const std::string_view key, const TwitchChatMessage &msg) {
 		// If the command does not exist, skip
-		if (!m_commandsMap.contains(key)) return;
-		// Make sure the command is enabled
-		if (!m_commandsMap[key].enabled) return;
-		// Set new last executed time
-		m_commandsMap[key].lastExecuted = std::chrono::steady_clock::now();
+		const auto index = m_index.load();
+		if (!index) return;
+		const auto it = std::ranges::find(index->idKeys, key);
+		if (it == index->idKeys.end()) return;
+		execute(*index, static_cast<std::uint32_t>(it - index->idKeys.begin()), msg);
+	}
+
+	// Method for dispatching chat message to the command it calls
+	// sender must be in global_config.approvedUsers, unless the list is empty
+	// identical messages within global_config.coalesceWindow are folded into the first one
+	static void dispatch_message(const TwitchChatMessage &msg) {
+		if (!global_config.approvedUsers.empty() &&
+			std::ranges::none_of(global_config.approvedUsers, [&](const auto &user) {
+				return lowercase(user) == lowercase(msg.user);
+			}))
+			return;
 
-		// Launch each subcommand in new thread
-		m_commandsMap[key].func(msg);
+		const auto command = msg.parsed->view(msg.parsed->command);
+		const auto id = find_command_id(command);
+		if (!id) return;
+
+		auto repeats =
+			CommandCoalescer::admit(command, msg.get_raw(), std::chrono::steady_clock::now());
+		if (!repeats) return;
+
+		const auto index = m_index.load();
+		if (!index || *id >= index->executions.size()) return;
+		auto coalescedMsg = msg;
+		coalescedMsg.repeats = std::move(repeats);
+		coalescedMsg.priority = index->executions[*id].priority;
+		execute(*index, *id, coalescedMsg);
 	}
 
 	static void add_command(const std::string &key, const Command &cmd) {
+		std::scoped_lock lock(m_commandsMutex);
+		// Keep ID of replaced command, so its cooldown state carries over
+		auto id = static_cast<std::uint32_t>(m_idKeys.size());
+		if (const auto it = m_commandsMap.find(key); it != m_commandsMap.end())
+			id = it->second.id;
+		else
+			m_idKeys.push_back(key);
+
 		m_commandsMap[key] = cmd;
+		m_commandsMap[key].id = id;
+		publish_index();
 	}
 
 	// Method for returning time when command was last executed
-	static auto get_last_executed_time(const std::string &key)
+	static auto get_last_executed_time(const std::string_view key)
 		-> std::chrono::time_point<std::chrono::steady_clock> {
 		// If the key does not exist, return epoch
-		if (!m_commandsMap.contains(key))
-			return std::chrono::time_point<std::chrono::steady_clock>();
+		const auto index = m_index.load();
+		if (!index) return {};
+		const auto it = std::ranges::find(index->idKeys, key);
+		const auto id = static_cast<std::size_t>(it - index->idKeys.begin());
+
+		std::scoped_lock lock(m_lastExecutedMutex);
+		return id < m_lastExecuted.size() ? m_lastExecuted[id]
+										  : std::chrono::time_point<std::chrono::steady_clock>();
+	}
+
+private:
+	// Runs command with given ID from the snapshot, which keeps its function alive meanwhile
+	static void execute(const CommandIndex &index, const std::uint32_t id,
+						const TwitchChatMessage &msg) {
+		// Make sure the command is enabled
+		const auto &execution = index.executions[id];
+		if (!execution.enabled || !execution.func) return;
+		// Set new last executed time
+		const auto now = std::chrono::steady_clock::now();
+		{
+			std::scoped_lock lock(m_lastExecutedMutex);
+			if (m_lastExecuted.size() <= id) m_lastExecuted.resize(id + 1);
+			m_lastExecuted[id] = now;
+		}
+		if (msg.trace) msg.trace->mark(LatencyStage::eExecuted, now);
+
+		execution.func(msg);
+	}
 
-		return m_commandsMap[key].lastExecuted;
+	// Builds lookups from the current commands, then publishes them
+	// requires m_commandsMutex to be held
+	static void publish_index() {
+		auto index = std::make_shared<CommandIndex>();
+		index->idKeys = m_idKeys;
+		index->schemas.resize(m_idKeys.size(), ArgSchema::make_default());
+		index->executions.resize(m_idKeys.size());
+		for (const auto &cmd : m_commandsMap | std::views::values) {
+			if (!cmd.callstr.empty()) index->callIds[lowercase(cmd.callstr)] = cmd.id;
+			index->schemas[cmd.id] = cmd.schema;
+			index->executions[cmd.id] = {cmd.func, cmd.enabled, cmd.priority};
+		}
+		m_index = std::move(index);
 	}
 };
\ No newline at end of file
@@ -6,6 +6,7 @@ module;
 export module common;
 
 import standard;
+import rng;
 
 // 2D and 3D position structs
 export struct Position2D {
@@ -24,10 +25,7 @@ export struct Position3D {
 
 // Method for returning random integer between min, max
 export auto random_int(const int min, const int max) -> int {
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	std::uniform_int_distribution dist(min, max);
-	return dist(gen);
+	return RandomHandler::next_int(min, max);
 }
 
 // Method for converting string to lowercase
@@ -36,6 +34,14 @@ export auto lowercase(std::string str) -> std::string {
 	return str;
 }
 
+// Hash for unordered containers with std::string keys, allows lookups with std::string_view
+export struct TransparentStringHash {
+	using is_transparent = void;
+	auto operator()(const std::string_view str) const -> std::size_t {
+		return std::hash<std::string_view>{}(str);
+	}
+};
+
 // Method for stripping away the extension from a filename string, if one is found
 export auto strip_extension(const std::string &filename) -> std::string {
 	return filename.find('.') != std::string::npos ? filename.substr(0, filename.find('.'))
@@ -107,20 +113,6 @@ export auto get_strings_between(const std::string &str, const std::string &start
 	return strings;
 }
 
-// Method for getting invidual letters of a string for multi-byte characters
-export auto get_letters_mb(const std::string &str) -> std::vector<std::string> {
-	std::vector<std::string> letters;
-	const auto *start = str.c_str();
-	const auto *end = start + str.size();
-	while (start < end) {
-		const auto bytes = std::mblen(start, end - start);
-		if (bytes < 1) break;
-		letters.emplace_back(start, start + bytes);
-		start += bytes;
-	}
-	return letters;
-}
-
 // Returns whether string has letters only
 export auto is_letters(const std::string &str) -> bool {
 	return std::ranges::all_of(str, [](const auto &ch) { return std::isalpha(ch); });
@@ -134,30 +126,73 @@ export auto remap_value(const float value, const float inMin, const float inMax,
 
 // Method for returning a GUID string
 export auto generate_guid() -> std::string {
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	std::uniform_int_distribution<int> dis(0, 15);
-	const std::string hex = "0123456789abcdef";
+	auto &gen = RandomHandler::generator();
+	constexpr std::string_view hex = "0123456789abcdef";
 	std::string uuid = "xxxxxxxx-xxxx-4xxx-yxxx-xxxxxxxxxxxx";
 	for (auto &ch : uuid) {
 		if (ch == 'x') {
-			ch = hex[dis(gen)];
+			ch = hex[gen.next_int(0, 15)];
 		} else if (ch == 'y') {
-			ch = hex[(dis(gen) & 0x3) | 0x8];
+			ch = hex[(gen.next_int(0, 15) & 0x3) | 0x8];
 		}
 	}
 	return uuid;
 }
 
-// Simple struct for returning an result code and message with arguments
-export struct Result {
-	int code = 0;
-	std::string message = "";
-	std::tuple<std::string> args = {};
+// Error codes shared by all modules, also used as exit codes so values must not change
+export enum class ErrorCode : std::uint8_t {
+	eInvalidArgument = 1, //< Call was given something it can't work with
+	eFileOpen,			  //< File or directory couldn't be opened or created
+	eFileFormat,		  //< File was opened, but its contents aren't what was expected
+	eAlreadyConnected,	  //< Connection was already open
+	eConnection,		  //< Connection couldn't be opened
+	eAuthentication,	  //< Login or OAuth flow failed
+	eAudioDevice,		  //< Audio device, context or a required extension is unavailable
+	eAudioResource,		  //< OpenAL buffer, source or effect couldn't be created
+	eWindow,			  //< Window or OpenGL context couldn't be created
+	eGui,				  //< ImGui backend couldn't be initialized
+	eMissingAsset,		  //< Required asset wasn't found
+};
 
-	explicit operator bool() const { return code == 0; }
+// Turns detail value of an error into text, e.g. OpenAL error enum into its name
+export using ErrorDetailFormatter = std::string (*)(std::int64_t);
+
+// Error of a failed call, nothing is allocated until it's described
+// message must be static text, anything varying goes into detail and is formatted lazily
+export struct Error {
+	ErrorCode code = ErrorCode::eInvalidArgument;
+	std::string_view message = "";
+	std::int64_t detail = 0; //< Cause of the error, e.g. HTTP status or OpenAL error
+	ErrorDetailFormatter formatDetail = nullptr; //< How detail is described, unused if null
+
+	// Returns message with formatted detail, for printing
+	[[nodiscard]] auto describe() const -> std::string {
+		if (!formatDetail) return std::string(message);
+		return std::format("{} ({})", message, formatDetail(detail));
+	}
 };
 
+// Result of a call returning nothing, value-returning calls use std::expected<T, Error>
+export using Result = std::expected<void, Error>;
+
+// Returns failure for Result or std::expected, e.g. return fail(ErrorCode::eFileOpen, "...")
+export constexpr auto fail(const ErrorCode code, const std::string_view message,
+						   const std::int64_t detail = 0,
+						   const ErrorDetailFormatter formatDetail = nullptr)
+	-> std::unexpected<Error> {
+	return std::unexpected(Error{code, message, detail, formatDetail});
+}
+
+// Formats detail as HTTP status code
+export auto format_http_status(const std::int64_t status) -> std::string {
+	return std::format("HTTP {}", status);
+}
+
+// Formats detail as OS error code, e.g. value of std::error_code from std::filesystem
+export auto format_system_error(const std::int64_t error) -> std::string {
+	return std::system_category().message(static_cast<int>(error));
+}
+
 // Template method for converting string to integer
 export template <typename T>
 requires std::is_integral_v<T>
@@ -196,6 +231,36 @@ constexpr auto floating_from_string(const std::string &str) -> T {
 		return std::stof(str);
 }
 
+// Reasons decoding a number out of text can fail
+export enum class DecodeError : std::uint8_t {
+	eEmpty,		 //< Nothing to decode
+	eInvalid,	 //< Not a number, has trailing characters or is not finite
+	eOutOfRange, //< Number doesn't fit the type
+};
+
+// Decodes number out of text without throwing, meant for untrusted input such as chat
+// whole text must be the number, surrounding whitespace and a leading '+' are allowed
+export template <typename T>
+requires std::is_arithmetic_v<T> && (!std::same_as<T, bool>)
+auto decode_number(std::string_view str) -> std::expected<T, DecodeError> {
+	const auto is_space = [](const char ch) {
+		return std::isspace(static_cast<unsigned char>(ch)) != 0;
+	};
+	while (!str.empty() && is_space(str.front())) str.remove_prefix(1);
+	while (!str.empty() && is_space(str.back())) str.remove_suffix(1);
+	if (str.starts_with('+') && !str.substr(1).starts_with('-')) str.remove_prefix(1);
+	if (str.empty()) return std::unexpected(DecodeError::eEmpty);
+
+	T value{};
+	const auto end = str.data() + str.size();
+	const auto [ptr, ec] = std::from_chars(str.data(), end, value);
+	if (ec == std::errc::result_out_of_range) return std::unexpected(DecodeError::eOutOfRange);
+	if (ec != std::errc() || ptr != end) return std::unexpected(DecodeError::eInvalid);
+	if constexpr (std::is_floating_point_v<T>)
+		if (!std::isfinite(value)) return std::unexpected(DecodeError::eInvalid);
+	return value;
+}
+
 // Stringable concept for checking if a type is convertible to a string
 export template <typename T>
 concept Stringable =
@@ -11,6 +11,8 @@ export module config;
 import standard;
 import common;
 import filesystem;
+import queue;
+import admission;
 
 // Enum for cooldown types
 export enum CommandCooldownType : std::uint8_t {
@@ -20,14 +22,29 @@ export enum CommandCooldownType : std::uint8_t {
 	ePerCommand = 1 << 2,
 };
 
+// Enum for how cooldowns admit commands
+export enum class CooldownMode : std::uint8_t {
+	eFixed,		  //< One use, then wait for the whole cooldown
+	eTokenBucket, //< cooldownBurst uses per cooldown window, refilling continuously
+};
+
 // Struct for a config option
 export template <typename T>
 struct ConfigOption {
 	T value;
 	T min;
 	T max;
+
+	// Brings value back within range, e.g. after a hand edited config was loaded
+	void clamp() { value = std::clamp(value, min, max); }
 };
 
+// Returns stored enum value, or fallback if it's past the last member
+template <typename E>
+auto enum_or(const std::underlying_type_t<E> value, const E last, const E fallback) -> E {
+	return value <= std::to_underlying(last) ? static_cast<E>(value) : fallback;
+}
+
 // Struct for keeping configs across launches
 export struct Config {
 	ConfigOption<float> notifAnimationLength{5.0f, 1.0f, 30.0f};
@@ -37,17 +54,42 @@ export struct Config {
 	ConfigOption<float> globalAudioVolume{0.5f, 0.0f, 1.0f};
 	std::vector<std::string> approvedUsers = {};
 	std::string twitchChannel = "", refreshToken = "";
+	std::string chatEndpoint = "ws://irc-ws.chat.twitch.tv:80"; //< IRC WebSocket to connect to
+	std::string oauthEndpoint = "https://id.twitch.tv/oauth2";  //< Base of OAuth authorize/token
+	bool chatAnonymous = false; //< Log in read-only as justinfan, without OAuth
 	CommandCooldownType enabledCooldowns = CommandCooldownType::eGlobal;
 	ConfigOption<std::uint32_t> cooldownGlobal{5, 1, 600};
 	ConfigOption<std::uint32_t> cooldownPerUser{5, 1, 600};
 	ConfigOption<std::uint32_t> cooldownPerCommand{5, 1, 600};
+	CooldownMode cooldownMode = CooldownMode::eFixed;
+	ConfigOption<std::uint32_t> cooldownBurst{3, 1, 100}; //< Uses per window in token bucket mode
 	ConfigOption<std::uint32_t> maxAudioTriggers{
 		3, 0, 10}; //< How many audio triggers can a message cause
+	bool triggerIgnoreCase = false; //< Trigger words of ascii art and sounds match in any case
 	ConfigOption<float> audioSequenceOffset{
 		-1.0f, -5.0f, 0.0f}; //< Offset for audio sequence, reduces time until next audio trigger
 	ConfigOption<float> ttsVoiceSpeed{1.0f, 0.1, 2.0f};	 //< Speed of TTS voice
 	ConfigOption<float> ttsVoiceVolume{1.0f, 0.1, 1.0f}; //< Volume of TTS voice
 	ConfigOption<float> ttsVoicePitch{1.0f, 0.1, 2.0f};	 //< Pitch of TTS voice
+	ConfigOption<std::uint32_t> chatQueueCapacity{
+		1024, 64, 65536}; //< Chat messages waiting for dispatch, applied on initialize
+	QueueOverflowPolicy chatQueueOverflow =
+		QueueOverflowPolicy::eDropOldest; //< What to do when chat queue is full
+	ConfigOption<std::uint32_t> userTableCapacity{
+		8192, 256, 1 << 20}; //< Chatters remembered for cooldowns, applied on initialize
+	ConfigOption<float> coalesceWindow{
+		2.0f, 0.0f, 30.0f}; //< Seconds identical commands are folded into one, 0 disables
+	ConfigOption<std::uint32_t> coalesceThreshold{
+		1, 1, 100}; //< Identical commands shown individually before folding starts
+	ConfigOption<std::uint32_t> maxNotifications{8, 1, 64}; //< Notifications live at once
+	ConfigOption<std::uint32_t> maxSoundSources{
+		64, 4, 255}; //< Sounds playing at once, ones fading out don't count
+	ConfigOption<std::uint32_t> admissionQueue{
+		16, 0, 256}; //< Notifications/sounds waiting for a free slot, each
+	AdmissionPolicy admissionPolicy =
+		AdmissionPolicy::eDropOldest; //< What to shed when slots and queue are full
+	ConfigOption<std::uint32_t> soundBankBudget{
+		64, 0, 1024}; //< MiB of decoded sound files kept for replay, 0 keeps none
 
 	auto save() -> Result {
 		nlohmann::json json;
@@ -59,6 +101,9 @@ export struct Config {
 		json["globalAudioVolume"] = globalAudioVolume.value;
 		json["twitchChannel"] = twitchChannel;
 		json["refreshToken"] = refreshToken;
+		json["chatEndpoint"] = chatEndpoint;
+		json["oauthEndpoint"] = oauthEndpoint;
+		json["chatAnonymous"] = chatAnonymous;
 		json["enabledCooldowns"] = enabledCooldowns;
 		json["cooldownGlobal"] = cooldownGlobal.value;
 		json["cooldownPerUser"] = cooldownPerUser.value;
@@ -68,6 +113,19 @@ export struct Config {
 		json["ttsVoiceSpeed"] = ttsVoiceSpeed.value;
 		json["ttsVoiceVolume"] = ttsVoiceVolume.value;
 		json["ttsVoicePitch"] = ttsVoicePitch.value;
+		json["chatQueueCapacity"] = chatQueueCapacity.value;
+		json["chatQueueOverflow"] = std::to_underlying(chatQueueOverflow);
+		json["userTableCapacity"] = userTableCapacity.value;
+		json["cooldownMode"] = std::to_underlying(cooldownMode);
+		json["cooldownBurst"] = cooldownBurst.value;
+		json["coalesceWindow"] = coalesceWindow.value;
+		json["coalesceThreshold"] = coalesceThreshold.value;
+		json["maxNotifications"] = maxNotifications.value;
+		json["maxSoundSources"] = maxSoundSources.value;
+		json["admissionQueue"] = admissionQueue.value;
+		json["soundBankBudget"] = soundBankBudget.value;
+		json["admissionPolicy"] = std::to_underlying(admissionPolicy);
+		json["triggerIgnoreCase"] = triggerIgnoreCase;
 
 		// Approved users has to be made into comma separated string
 		std::string approvedUsersStr;
@@ -76,6 +134,7 @@ export struct Config {
 		json["approvedUsers"] = approvedUsersStr;
 
 		std::ofstream file(get_config_path());
+		if (!file.is_open()) return fail(ErrorCode::eFileOpen, "Failed to open config file");
 		file << json.dump(4);
 		file.close();
 
@@ -91,7 +150,9 @@ export struct Config {
 		const std::string file_contents((std::istreambuf_iterator<char>(file)),
 										std::istreambuf_iterator<char>());
 
-		auto json = nlohmann::json::parse(file_contents);
+		// Don't throw on malformed config, it's replaced with current values on next save
+		auto json = nlohmann::json::parse(file_contents, nullptr, false);
+		if (json.is_discarded()) return fail(ErrorCode::eFileFormat, "Invalid config file");
 
 		notifAnimationLength.value = json["notifAnimationLength"].get<float>();
 		notifEffectSpeed.value = json["notifEffectSpeed"].get<float>();
@@ -110,6 +171,28 @@ export struct Config {
 		ttsVoiceSpeed.value = json["ttsVoiceSpeed"].get<float>();
 		ttsVoiceVolume.value = json["ttsVoiceVolume"].get<float>();
 		ttsVoicePitch.value = json["ttsVoicePitch"].get<float>();
+		// Newer options may be missing from older configs
+		chatQueueCapacity.value = json.value("chatQueueCapacity", chatQueueCapacity.value);
+		chatQueueOverflow =
+			enum_or(json.value("chatQueueOverflow", std::to_underlying(chatQueueOverflow)),
+					QueueOverflowPolicy::eBlock, QueueOverflowPolicy::eDropNewest);
+		userTableCapacity.value = json.value("userTableCapacity", userTableCapacity.value);
+		cooldownMode = enum_or(json.value("cooldownMode", std::to_underlying(cooldownMode)),
+							   CooldownMode::eTokenBucket, CooldownMode::eFixed);
+		cooldownBurst.value = json.value("cooldownBurst", cooldownBurst.value);
+		chatEndpoint = json.value("chatEndpoint", chatEndpoint);
+		oauthEndpoint = json.value("oauthEndpoint", oauthEndpoint);
+		chatAnonymous = json.value("chatAnonymous", chatAnonymous);
+		coalesceWindow.value = json.value("coalesceWindow", coalesceWindow.value);
+		coalesceThreshold.value = json.value("coalesceThreshold", coalesceThreshold.value);
+		maxNotifications.value = json.value("maxNotifications", maxNotifications.value);
+		maxSoundSources.value = json.value("maxSoundSources", maxSoundSources.value);
+		admissionQueue.value = json.value("admissionQueue", admissionQueue.value);
+		soundBankBudget.value = json.value("soundBankBudget", soundBankBudget.value);
+		admissionPolicy =
+			enum_or(json.value("admissionPolicy", std::to_underlying(admissionPolicy)),
+					AdmissionPolicy::eLowestPriority, AdmissionPolicy::eDropOldest);
+		triggerIgnoreCase = json.value("triggerIgnoreCase", triggerIgnoreCase);
 
 		// Approved users has to be made into vector from comma separated string
 		const auto approvedUsersStr = json["approvedUsers"].get<std::string>();
@@ -119,6 +202,7 @@ export struct Config {
 			if (!user.empty()) approvedUsers.push_back(user);
 		}
 
+		clamp_options();
 		return Result();
 	}
 
@@ -132,6 +216,9 @@ export struct Config {
 		json["globalAudioVolume"] = globalAudioVolume.value;
 		json["twitchChannel"] = twitchChannel;
 		json["refreshToken"] = refreshToken;
+		json["chatEndpoint"] = chatEndpoint;
+		json["oauthEndpoint"] = oauthEndpoint;
+		json["chatAnonymous"] = chatAnonymous;
 		json["enabledCooldowns"] = enabledCooldowns;
 		json["cooldownGlobal"] = cooldownGlobal.value;
 		json["cooldownPerUser"] = cooldownPerUser.value;
@@ -141,6 +228,19 @@ export struct Config {
 		json["ttsVoiceSpeed"] = ttsVoiceSpeed.value;
 		json["ttsVoiceVolume"] = ttsVoiceVolume.value;
 		json["ttsVoicePitch"] = ttsVoicePitch.value;
+		json["chatQueueCapacity"] = chatQueueCapacity.value;
+		json["chatQueueOverflow"] = std::to_underlying(chatQueueOverflow);
+		json["userTableCapacity"] = userTableCapacity.value;
+		json["cooldownMode"] = std::to_underlying(cooldownMode);
+		json["cooldownBurst"] = cooldownBurst.value;
+		json["coalesceWindow"] = coalesceWindow.value;
+		json["coalesceThreshold"] = coalesceThreshold.value;
+		json["maxNotifications"] = maxNotifications.value;
+		json["maxSoundSources"] = maxSoundSources.value;
+		json["admissionQueue"] = admissionQueue.value;
+		json["soundBankBudget"] = soundBankBudget.value;
+		json["admissionPolicy"] = std::to_underlying(admissionPolicy);
+		json["triggerIgnoreCase"] = triggerIgnoreCase;
 
 		// Approved users has to be made into comma separated string
 		std::string approvedUsersStr;
@@ -171,6 +271,28 @@ export struct Config {
 		ttsVoiceSpeed.value = json["ttsVoiceSpeed"].get<float>();
 		ttsVoiceVolume.value = json["ttsVoiceVolume"].get<float>();
 		ttsVoicePitch.value = json["ttsVoicePitch"].get<float>();
+		// Newer options may be missing from older configs
+		chatQueueCapacity.value = json.value("chatQueueCapacity", chatQueueCapacity.value);
+		chatQueueOverflow =
+			enum_or(json.value("chatQueueOverflow", std::to_underlying(chatQueueOverflow)),
+					QueueOverflowPolicy::eBlock, QueueOverflowPolicy::eDropNewest);
+		userTableCapacity.value = json.value("userTableCapacity", userTableCapacity.value);
+		cooldownMode = enum_or(json.value("cooldownMode", std::to_underlying(cooldownMode)),
+							   CooldownMode::eTokenBucket, CooldownMode::eFixed);
+		cooldownBurst.value = json.value("cooldownBurst", cooldownBurst.value);
+		chatEndpoint = json.value("chatEndpoint", chatEndpoint);
+		oauthEndpoint = json.value("oauthEndpoint", oauthEndpoint);
+		chatAnonymous = json.value("chatAnonymous", chatAnonymous);
+		coalesceWindow.value = json.value("coalesceWindow", coalesceWindow.value);
+		coalesceThreshold.value = json.value("coalesceThreshold", coalesceThreshold.value);
+		maxNotifications.value = json.value("maxNotifications", maxNotifications.value);
+		maxSoundSources.value = json.value("maxSoundSources", maxSoundSources.value);
+		admissionQueue.value = json.value("admissionQueue", admissionQueue.value);
+		soundBankBudget.value = json.value("soundBankBudget", soundBankBudget.value);
+		admissionPolicy =
+			enum_or(json.value("admissionPolicy", std::to_underlying(admissionPolicy)),
+					AdmissionPolicy::eLowestPriority, AdmissionPolicy::eDropOldest);
+		triggerIgnoreCase = json.value("triggerIgnoreCase", triggerIgnoreCase);
 
 		// Approved users has to be made into vector from comma separated string
 		const auto approvedUsersStr = json["approvedUsers"].get<std::string>();
@@ -179,9 +301,27 @@ export struct Config {
 		for (const auto &user : splitted) {
 			if (!user.empty()) approvedUsers.push_back(user);
 		}
+
+		clamp_options();
 	}
 
 private:
+	// Clamps every option to its range, values outside it may come from older or edited configs
+	void clamp_options() {
+		enabledCooldowns = static_cast<CommandCooldownType>(
+			enabledCooldowns & (CommandCooldownType::eGlobal | CommandCooldownType::ePerUser |
+								CommandCooldownType::ePerCommand));
+		for (auto *option : {&notifAnimationLength, &notifEffectSpeed, &notifEffectIntensity,
+							 &notifFontScale, &globalAudioVolume, &audioSequenceOffset,
+							 &ttsVoiceSpeed, &ttsVoiceVolume, &ttsVoicePitch, &coalesceWindow})
+			option->clamp();
+		for (auto *option :
+			 {&cooldownGlobal, &cooldownPerUser, &cooldownPerCommand, &cooldownBurst,
+			  &maxAudioTriggers, &chatQueueCapacity, &userTableCapacity, &coalesceThreshold,
+			  &maxNotifications, &maxSoundSources, &admissionQueue, &soundBankBudget})
+			option->clamp();
+	}
+
 	static auto get_config_path() -> std::filesystem::path {
 		return Filesystem::get_root_path() / "config.json";
 	}
@@ -0,0 +1,164 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module cooldown;
+
+import standard;
+import config;
+
+// Cooldown state of a single key (global, user or command), small enough to embed in records
+export struct CooldownState {
+	std::uint64_t owner = 0;  //< Who scheduled the running cooldown, guards against reused records
+	std::int64_t lastMs = 0;  //< Last time tokens were taken, in token bucket mode
+	float debt = 0.0f;		  //< Tokens taken and not yet refilled, in token bucket mode
+	bool cooling = false;	  //< Whether fixed cooldown is running, cleared by the timing wheel
+};
+
+// Hashed timing wheel, entries clear their state's cooling flag once the wheel passes them
+class TimingWheel {
+	static constexpr std::int64_t resolution_ms = 100;
+	static constexpr std::size_t slot_count = 1024;
+
+	struct Entry {
+		std::int64_t expiryMs;
+		CooldownState *state;
+		std::uint64_t owner;
+	};
+
+	std::array<std::vector<Entry>, slot_count> m_slots;
+	std::int64_t m_currentTick = 0;
+	std::size_t m_size = 0;
+
+public:
+	// Schedules state to stop cooling at given time
+	// rounded up to the tick at or after expiry, so the pass over that slot always fires it
+	void schedule(CooldownState *state, const std::uint64_t owner, const std::int64_t expiryMs) {
+		const auto tick = (expiryMs + resolution_ms - 1) / resolution_ms;
+		if (tick <= m_currentTick) {
+			state->cooling = false;
+			return;
+		}
+		m_slots[tick % slot_count].push_back({expiryMs, state, owner});
+		++m_size;
+	}
+
+	// Advances wheel up to given time, firing every entry that has expired
+	void advance(const std::int64_t nowMs) {
+		const auto target = nowMs / resolution_ms;
+		if (target <= m_currentTick) return;
+
+		// Entries further than one rotation away stay in their slot until their round comes
+		const auto steps = std::min<std::int64_t>(target - m_currentTick, slot_count);
+		for (std::int64_t i = 1; i <= steps; ++i) {
+			m_size -= std::erase_if(m_slots[(m_currentTick + i) % slot_count],
+									[nowMs](const Entry &entry) {
+										if (entry.expiryMs > nowMs) return false;
+										if (entry.state->owner == entry.owner)
+											entry.state->cooling = false;
+										return true;
+									});
+		}
+		m_currentTick = target;
+	}
+
+	void clear() {
+		for (auto &slot : m_slots) slot.clear();
+		m_currentTick = 0;
+		m_size = 0;
+	}
+
+	[[nodiscard]] auto size() const -> std::size_t { return m_size; }
+};
+
+// Class for admitting commands through global, per-user and per-command cooldowns
+// meant to be used from a single thread, the chat IO thread
+export class CooldownHandler {
+	static inline std::chrono::time_point<std::chrono::steady_clock> m_epoch;
+	static inline TimingWheel m_wheel;
+	static inline CooldownState m_globalState;
+	// Indexed by command ID, deque keeps states in place while growing
+	static inline std::deque<CooldownState> m_commandStates;
+
+public:
+	static void initialize() {
+		m_epoch = std::chrono::steady_clock::now();
+		m_wheel.clear();
+		m_globalState = {};
+		m_commandStates.clear();
+	}
+
+	// Decides whether command may run, checking every enabled cooldown before starting any
+	// userState/userOwner belong to the sender, commandId is nullopt for unknown commands
+	// @return true if admitted, in which case the cooldowns have been started
+	static auto admit(const std::chrono::time_point<std::chrono::steady_clock> now,
+					  CooldownState &userState, const std::uint64_t userOwner,
+					  const bool bypassUser, const std::optional<std::uint32_t> commandId)
+		-> bool {
+		const auto nowMs =
+			std::chrono::duration_cast<std::chrono::milliseconds>(now - m_epoch).count();
+		m_wheel.advance(nowMs);
+
+		const auto enabled = global_config.enabledCooldowns;
+		const auto useGlobal = (enabled & CommandCooldownType::eGlobal) != 0;
+		const auto useUser = (enabled & CommandCooldownType::ePerUser) != 0 && !bypassUser;
+		auto *commandState = (enabled & CommandCooldownType::ePerCommand) && commandId
+								 ? &get_command_state(*commandId)
+								 : nullptr;
+
+		if (useGlobal && !is_ready(m_globalState, nowMs, global_config.cooldownGlobal.value))
+			return false;
+		if (useUser && !is_ready(userState, nowMs, global_config.cooldownPerUser.value))
+			return false;
+		if (commandState &&
+			!is_ready(*commandState, nowMs, global_config.cooldownPerCommand.value))
+			return false;
+
+		if (useGlobal) start(m_globalState, 0, nowMs, global_config.cooldownGlobal.value);
+		if (useUser) start(userState, userOwner, nowMs, global_config.cooldownPerUser.value);
+		if (commandState)
+			start(*commandState, *commandId, nowMs, global_config.cooldownPerCommand.value);
+		return true;
+	}
+
+	// Returns number of fixed cooldowns currently running
+	static auto get_active_cooldowns() -> std::size_t { return m_wheel.size(); }
+
+private:
+	static auto get_command_state(const std::uint32_t commandId) -> CooldownState & {
+		if (commandId >= m_commandStates.size()) m_commandStates.resize(commandId + 1);
+		return m_commandStates[commandId];
+	}
+
+	// Token bucket refills continuously, burst tokens per cooldown window
+	static auto refilled_debt(const CooldownState &state, const std::int64_t nowMs,
+							  const std::uint32_t windowSeconds) -> float {
+		const auto burst = static_cast<float>(global_config.cooldownBurst.value);
+		const auto refill = static_cast<float>(nowMs - state.lastMs) * burst /
+							(static_cast<float>(windowSeconds) * 1000.0f);
+		return std::max(0.0f, state.debt - refill);
+	}
+
+	static auto is_ready(const CooldownState &state, const std::int64_t nowMs,
+						 const std::uint32_t windowSeconds) -> bool {
+		if (global_config.cooldownMode == CooldownMode::eTokenBucket)
+			return refilled_debt(state, nowMs, windowSeconds) + 1.0f <=
+				   static_cast<float>(global_config.cooldownBurst.value);
+
+		return !state.cooling;
+	}
+
+	static void start(CooldownState &state, const std::uint64_t owner, const std::int64_t nowMs,
+					  const std::uint32_t windowSeconds) {
+		if (global_config.cooldownMode == CooldownMode::eTokenBucket) {
+			state.debt = refilled_debt(state, nowMs, windowSeconds) + 1.0f;
+			state.lastMs = nowMs;
+			return;
+		}
+
+		state.owner = owner;
+		state.cooling = true;
+		m_wheel.schedule(&state, owner, nowMs + static_cast<std::int64_t>(windowSeconds) * 1000);
+	}
+};
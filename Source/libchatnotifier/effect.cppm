@@ -11,6 +11,7 @@ export module effect;
 
 import standard;
 import common;
+import utf8;
 
 // Text Effect system for text notifications //
 
@@ -60,8 +61,10 @@ auto multiply_colors(const ImVec4 &c1, const ImVec4 &c2) -> ImVec4 {
 }
 
 // CharacterData struct, holds data for text characters
+// the character itself is a range of bytes in the text it belongs to
 export struct CharacterData {
-	const std::string letter;					  //< Letter of the character
+	char32_t codepoint = 0;						  //< Code point of the character
+	std::uint32_t offset = 0, length = 0;		  //< Bytes of the character in the text
 	std::optional<float> offsetY = std::nullopt;  //< Additional offset of the character
 	std::optional<float> offsetX = std::nullopt;  //< Additional offset of the character
 	std::optional<float> sizeX = std::nullopt;	  //< Size override of the character
@@ -70,19 +73,22 @@ export struct CharacterData {
 	std::optional<float> rotation = std::nullopt; //< Separate rotation of the character
 
 	CharacterData() = delete;
-	explicit CharacterData(const std::string &letterStr) : letter(letterStr) {}
+	explicit CharacterData(const Utf8Char &ch)
+		: codepoint(ch.codepoint), offset(ch.offset), length(ch.length) {}
 
-	auto apply(const ImVec4 &upperColor, const TextEffectFlags &flags) const -> void {
+	// letterSize is the measured size of the character, from TextMetrics
+	auto apply(const std::string &text, const ImVec2 &letterSize, const ImVec4 &upperColor,
+			   const TextEffectFlags &flags) const -> void {
 		if (rotation) RotateBegin();
 		if (color) ImGui::PushStyleColor(ImGuiCol_Text, multiply_colors(*color, upperColor));
 		const auto vtxBufIdx = ImGui::GetWindowDrawList()->VtxBuffer.Size;
 
 		// Create data for the character
-		ImGui::TextUnformatted(letter.c_str());
+		const auto *letterBegin = text.data() + offset;
+		ImGui::TextUnformatted(letterBegin, letterBegin + length);
 
 		// Modify vtx buffer directly to apply effects
 		auto &vtxBuf = ImGui::GetWindowDrawList()->VtxBuffer;
-		const auto &letterSize = ImGui::CalcTextSize(letter.c_str());
 		for (int i = vtxBufIdx; i < vtxBuf.Size; i++) {
 			if (offsetX) vtxBuf[i].pos.x += *offsetX;
 			if (offsetY) vtxBuf[i].pos.y += *offsetY;
@@ -95,10 +101,18 @@ export struct CharacterData {
 	}
 };
 
+// Measured sizes of a text line, only valid for the font they were measured with
+export struct TextMetrics {
+	ImVec2 size = ImVec2(0.0f, 0.0f); //< Size of the whole line
+	std::vector<ImVec2> glyphSizes;	  //< Size of each character, same indices as characters
+};
+
 // TextEffectData struct, holds data for text effects that is passed between effects
 export struct TextEffectData {
 	std::string text;							   //< Text of the effect
 	std::vector<CharacterData> characters;		   //< Characters of the text
+	bool lettersOnly = false;					   //< Text has letters only, see is_letters
+	std::shared_ptr<TextMetrics> metrics;		   //< Shared by every copy made while rendering
 	ImFont *font = nullptr;						   //< Main font of the text
 	std::optional<ImVec2> position = std::nullopt; //< Position of the text from the top left corner
 	std::optional<ImVec2> size = std::nullopt;	   //< Main size of the text
@@ -111,20 +125,43 @@ export struct TextEffectData {
 
 	TextEffectData() = delete;
 	explicit TextEffectData(const std::string &text) { set_text(text); }
+	// From line decoded ahead of time, e.g. of cached ascii art
+	explicit TextEffectData(const Utf8Line &line)
+		: text(line.text), lettersOnly(is_letters(text)),
+		  metrics(std::make_shared<TextMetrics>()) {
+		characters.reserve(line.characters.size());
+		for (const auto &ch : line.characters) characters.emplace_back(ch);
+	}
 
 	auto set_text(const std::string &textstr) -> void {
 		text = textstr;
 		characters.clear();
-		const auto letters = get_letters_mb(text);
-		characters.reserve(letters.size());
-		for (const auto &letter : letters) characters.emplace_back(letter);
+		characters.reserve(text.size());
+		for_each_utf8_char(text, [this](const Utf8Char &ch) { characters.emplace_back(ch); });
+		lettersOnly = is_letters(text);
+		metrics = std::make_shared<TextMetrics>();
+	}
+
+	// Measures text and each of its characters with the current font
+	auto measure() const -> void {
+		if (font != nullptr) ImGui::PushFont(font);
+		const auto *textBegin = text.data();
+		metrics->size = ImGui::CalcTextSize(textBegin, textBegin + text.size());
+		metrics->glyphSizes.clear();
+		metrics->glyphSizes.reserve(characters.size());
+		for (const auto &character : characters) {
+			const auto *letterBegin = textBegin + character.offset;
+			metrics->glyphSizes.push_back(
+				ImGui::CalcTextSize(letterBegin, letterBegin + character.length));
+		}
+		if (font != nullptr) ImGui::PopFont();
 	}
 
 	auto apply(const ImVec2 &rootPos, const TextEffectFlags &flags) const -> void {
 		if (characters.empty()) return;
 		if (rotation) RotateBegin();
 		if (font != nullptr) ImGui::PushFont(font);
-		const auto &textSize = ImGui::CalcTextSize(text.c_str());
+		const auto &textSize = metrics->size;
 
 		// If flag is centered, center this text horizontally
 		if (flags == TextEffectFlags::eCenteredHorizontal) {
@@ -134,9 +171,10 @@ export struct TextEffectData {
 		}
 
 		const auto vtxBufIdx = ImGui::GetWindowDrawList()->VtxBuffer.Size;
+		const auto upperColor = color.value_or(ImVec4(1.0f, 1.0f, 1.0f, 1.0f));
 		for (int i = 0; i < characters.size(); i++) {
-			characters[i].apply(color.value_or(ImVec4(1.0f, 1.0f, 1.0f, 1.0f)), flags);
-			if (i < characters.size() - 1) ImGui::SameLine(0.0f, is_letters(text) ? -1.0f : 0.0f);
+			characters[i].apply(text, metrics->glyphSizes[i], upperColor, flags);
+			if (i < characters.size() - 1) ImGui::SameLine(0.0f, lettersOnly ? -1.0f : 0.0f);
 		}
 
 		// Same here, buffer modification but for the whole text
@@ -182,9 +220,12 @@ public:
 // TextEffectMix class, makes multiple text effects run after each other
 export class TextEffectMix {
 	MixData m_mixData;
-	std::string m_fullText;
 	std::vector<TextEffectData> m_textLines = {};
 	std::vector<std::shared_ptr<TextEffect>> m_effects = {};
+	// Font the lines were last measured with, they're measured again when it changes
+	mutable const ImFont *m_measuredFont = nullptr;
+	mutable float m_measuredFontSize = 0.0f;
+	mutable ImVec2 m_fullTextSize = ImVec2(0.0f, 0.0f);
 
 public:
 	TextEffectMix() = default;
@@ -198,13 +239,16 @@ public:
 	auto setMixSpeed(const float &speed) -> void { m_mixData.speed = speed; }
 	auto setMixIntensity(const float &intensity) -> void { m_mixData.intensity = intensity; }
 
-	auto set_text(const std::string &text) -> void {
-		m_fullText = text;
+	auto set_text(const std::string &text) -> void { set_text({}, text); }
+
+	// Sets text to lines decoded ahead of time followed by lines of text
+	auto set_text(const std::span<const Utf8Line> leadingLines, const std::string &text) -> void {
 		m_textLines.clear();
-		// Split text into lines
-		const auto lines = split_string(m_fullText, "\n");
-		m_textLines.reserve(lines.size());
+		const auto lines = decode_utf8_lines(text);
+		m_textLines.reserve(leadingLines.size() + lines.size());
+		for (const auto &line : leadingLines) m_textLines.emplace_back(line);
 		for (const auto &line : lines) m_textLines.emplace_back(line);
+		m_measuredFont = nullptr;
 	}
 
 	auto render(ImFont *mainFont, const float &time,
@@ -212,10 +256,11 @@ public:
 		if (mainFont != nullptr) ImGui::PushFont(mainFont);
 		constexpr auto rootPos = ImVec2(0.0f, 0.0f);
 		ImGui::SetCursorPosY(rootPos.y);
+		measure();
 		for (int i = 0; i < m_textLines.size(); i++) {
 			auto line = m_textLines[i];
 			line.cursorPos = ImGui::GetCursorPos();
-			line.textSize = ImGui::CalcTextSize(m_fullText.c_str());
+			line.textSize = m_fullTextSize;
 			for (const auto &effect : m_effects) line = effect->run(line, m_mixData, time);
 			line.apply(rootPos, flags);
 		}
@@ -235,6 +280,24 @@ public:
 	auto add_effect(Args &&...args) -> void {
 		m_effects.push_back(std::make_shared<Effect>(std::forward<Args>(args)...));
 	}
+
+private:
+	// Measures the text and its lines, unless already measured with the current font and scale
+	auto measure() const -> void {
+		const auto *font = ImGui::GetFont();
+		const auto fontSize = ImGui::GetFontSize();
+		if (font == m_measuredFont && fontSize == m_measuredFontSize) return;
+
+		m_measuredFont = font;
+		m_measuredFontSize = fontSize;
+		// Whole text is as wide as its widest line and as tall as its lines together
+		m_fullTextSize = ImVec2(0.0f, 0.0f);
+		for (const auto &line : m_textLines) {
+			line.measure();
+			m_fullTextSize.x = std::max(m_fullTextSize.x, line.metrics->size.x);
+			m_fullTextSize.y += line.metrics->size.y;
+		}
+	}
 };
 
 // TextEffectWave, makes a rolling wave with characters
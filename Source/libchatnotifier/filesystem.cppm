@@ -13,7 +13,7 @@ export class Filesystem {
 
 public:
 	static auto initialize(const int argc, char **argv) -> Result {
-		if (argc < 1) return Result(1, "Invalid argc provided");
+		if (argc < 1) return fail(ErrorCode::eInvalidArgument, "Invalid argc provided");
 
 		root_path = argv[0];
 		//root_path = root_path.parent_path();
@@ -0,0 +1,372 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module grammar;
+
+import standard;
+import common;
+import config;
+
+// Span of text within ParsedMessage::source, offsets stay valid when the message is moved
+export struct TextSpan {
+	std::uint32_t offset = 0, length = 0;
+
+	[[nodiscard]] constexpr auto empty() const -> bool { return length == 0; }
+};
+
+// Argument keys known by the built-in commands, other keys are only reachable by name
+export enum class ArgKey : std::uint8_t {
+	ePitch,
+	eOffset,
+	ePos,
+	eSfx,
+	eVfx,
+	eIntensity,
+	eSpeed,
+	eCount
+};
+
+constexpr auto arg_key_count = std::to_underlying(ArgKey::eCount);
+constexpr std::array<std::string_view, arg_key_count> arg_key_names = {
+	"pitch", "offset", "pos", "sfx", "vfx", "intensity", "speed"};
+
+export constexpr auto get_arg_key_name(const ArgKey key) -> std::string_view {
+	return arg_key_names[std::to_underlying(key)];
+}
+
+// Perfect hash of the known keys, seeded FNV-1a with the seed searched for at compile time
+constexpr std::size_t arg_table_size = 16;
+constexpr auto arg_key_hash(const std::uint32_t seed, const std::string_view key) -> std::size_t {
+	std::uint32_t hash = seed;
+	for (const auto ch : key) hash = (hash ^ static_cast<std::uint8_t>(ch)) * 16777619u;
+	return (hash >> 16) % arg_table_size;
+}
+
+constexpr auto arg_hash_seed = [] {
+	for (std::uint32_t seed = 2166136261u; seed < 2166136261u + 4096; ++seed) {
+		std::array<bool, arg_table_size> used{};
+		if (std::ranges::all_of(arg_key_names, [&](const auto name) {
+				return !std::exchange(used[arg_key_hash(seed, name)], true);
+			}))
+			return seed;
+	}
+	return 0u;
+}();
+static_assert(arg_hash_seed != 0, "No perfect hash seed for argument keys");
+
+constexpr auto arg_key_table = [] {
+	std::array<ArgKey, arg_table_size> table{};
+	table.fill(ArgKey::eCount);
+	for (std::size_t i = 0; i < arg_key_count; ++i)
+		table[arg_key_hash(arg_hash_seed, arg_key_names[i])] = static_cast<ArgKey>(i);
+	return table;
+}();
+
+// Returns known key of given name, nullopt if it's not one of them
+export constexpr auto find_arg_key(const std::string_view name) -> std::optional<ArgKey> {
+	const auto key = arg_key_table[arg_key_hash(arg_hash_seed, name)];
+	if (key == ArgKey::eCount || get_arg_key_name(key) != name) return std::nullopt;
+	return key;
+}
+
+// How a command treats a known argument, numeric values are clamped into [min, max]
+export struct ArgRule {
+	bool accepted = true;
+	double min = std::numeric_limits<double>::lowest();
+	double max = std::numeric_limits<double>::max();
+};
+
+// Arguments a command accepts, applied once while parsing its messages
+// known arguments not accepted are dropped, unknown ones are always kept as they are
+export struct ArgSchema {
+	std::array<ArgRule, arg_key_count> rules;
+
+	// Schema accepting every known argument within the ranges the rest of the program handles
+	static auto make_default() -> ArgSchema {
+		ArgSchema schema;
+		schema.rule(ArgKey::ePitch) = {true, 0.1, 2.0};
+		schema.rule(ArgKey::eIntensity) = {true, global_config.notifEffectIntensity.min,
+										   global_config.notifEffectIntensity.max};
+		schema.rule(ArgKey::eSpeed) = {true, global_config.notifEffectSpeed.min,
+									   global_config.notifEffectSpeed.max};
+		return schema;
+	}
+
+	// Schema accepting only given arguments, each narrowed within the default range of it
+	static auto make_only(const std::map<ArgKey, std::optional<std::pair<double, double>>> &keys)
+		-> ArgSchema {
+		auto schema = make_default();
+		for (auto &rule : schema.rules) rule.accepted = false;
+		for (const auto &[key, range] : keys) {
+			auto &rule = schema.rule(key);
+			rule.accepted = true;
+			if (range) {
+				rule.min = std::clamp(std::min(range->first, range->second), rule.min, rule.max);
+				rule.max = std::clamp(std::max(range->first, range->second), rule.min, rule.max);
+			}
+		}
+		return schema;
+	}
+
+	[[nodiscard]] auto rule(const ArgKey key) -> ArgRule & {
+		return rules[std::to_underlying(key)];
+	}
+	[[nodiscard]] auto rule(const ArgKey key) const -> const ArgRule & {
+		return rules[std::to_underlying(key)];
+	}
+};
+
+// Argument of a group, "key=value1|value2"
+export struct ParsedArg {
+	TextSpan key;
+	std::uint32_t firstValue = 0, valueCount = 0; //< Range in ParsedMessage::values
+	ArgKey known = ArgKey::eCount;				  //< eCount if key is not a known one
+};
+
+// Index of an argument not given
+export constexpr std::uint32_t no_arg = std::numeric_limits<std::uint32_t>::max();
+
+// Argument group "<...>" and the text following it
+export struct ParsedGroup {
+	std::uint32_t firstArg = 0, argCount = 0; //< Range in ParsedMessage::args
+	TextSpan text;
+	// Index in ParsedMessage::args of each known argument, the last one if given multiple times
+	std::array<std::uint32_t, arg_key_count> knownArgs = [] {
+		std::array<std::uint32_t, arg_key_count> indices{};
+		indices.fill(no_arg);
+		return indices;
+	}();
+};
+
+// Flat representation of "!cmd <arg1=value1,arg2=value2|value3> text <arg3=value4> more text"
+// tables reference each other by index and the source by span, so one parse serves every accessor
+// everything lives in an arena inside the struct, so a message takes a single heap allocation
+// unless it's unusually long, the struct is not copyable or movable because of it
+export struct ParsedMessage {
+	std::array<std::byte, 1536> arenaBuffer;
+	std::pmr::monotonic_buffer_resource arena{arenaBuffer.data(), arenaBuffer.size()};
+
+	std::pmr::string source{&arena};
+	TextSpan message; //< Whole message, source may have extra data appended after it
+	TextSpan command; //< Empty if message is not a command
+	TextSpan text;	  //< Text after the command, used when there are no groups
+	bool isCommand = false;
+	std::pmr::vector<ParsedGroup> groups{&arena};
+	std::pmr::vector<ParsedArg> args{&arena};
+	std::pmr::vector<TextSpan> values{&arena};
+	std::pmr::vector<std::expected<double, DecodeError>> numbers{&arena}; //< Values decoded once
+
+	ParsedMessage() = default;
+	ParsedMessage(const ParsedMessage &) = delete;
+	auto operator=(const ParsedMessage &) -> ParsedMessage & = delete;
+
+	// Reserves tables for the worst case of message, so none of them grows within the arena
+	void reserve(const std::string_view message) {
+		std::size_t groupCount = 0, argCount = 0, valueCount = 0;
+		for (const auto ch : message) {
+			groupCount += ch == '<';
+			argCount += ch == ',';
+			valueCount += ch == '|';
+		}
+		argCount += groupCount;
+		valueCount += argCount;
+		groups.reserve(std::max<std::size_t>(groupCount, 1));
+		args.reserve(argCount);
+		values.reserve(valueCount);
+		numbers.reserve(valueCount);
+	}
+
+	[[nodiscard]] auto view(const TextSpan span) const -> std::string_view {
+		return std::string_view(source).substr(span.offset, span.length);
+	}
+
+	// Returns known argument of group, the last one if key is given multiple times
+	[[nodiscard]] auto find_arg(const std::size_t group, const ArgKey key) const
+		-> const ParsedArg * {
+		if (group >= groups.size()) return nullptr;
+		const auto index = groups[group].knownArgs[std::to_underlying(key)];
+		return index == no_arg ? nullptr : &args[index];
+	}
+
+	// Returns argument of group by key, unknown keys are searched from the rest of its args
+	[[nodiscard]] auto find_arg(const std::size_t group, const std::string_view key) const
+		-> const ParsedArg * {
+		if (const auto known = find_arg_key(key)) return find_arg(group, *known);
+		if (group >= groups.size()) return nullptr;
+		const auto groupArgs =
+			std::span(args).subspan(groups[group].firstArg, groups[group].argCount);
+		for (const auto &arg : groupArgs | std::views::reverse)
+			if (arg.known == ArgKey::eCount && view(arg.key) == key) return &arg;
+		return nullptr;
+	}
+
+	// Returns values of given argument
+	[[nodiscard]] auto get_values(const ParsedArg &arg) const -> std::span<const TextSpan> {
+		return std::span(values).subspan(arg.firstValue, arg.valueCount);
+	}
+
+	// Returns values of given argument as numbers, decoded at parse time
+	[[nodiscard]] auto get_numbers(const ParsedArg &arg) const
+		-> std::span<const std::expected<double, DecodeError>> {
+		return std::span(numbers).subspan(arg.firstValue, arg.valueCount);
+	}
+
+	// Adds value, decoding it as number right away so accessors never have to
+	void add_value(const TextSpan value) {
+		values.push_back(value);
+		numbers.push_back(decode_number<double>(view(value)));
+	}
+
+	// Applies schema to the last added argument of group
+	// drops it if not accepted, otherwise clamps its numbers and indexes it if it's known
+	void finish_arg(ParsedGroup &group, const ArgSchema &schema) {
+		auto &arg = args.back();
+		const auto known = find_arg_key(view(arg.key));
+		if (!known) return;
+
+		const auto &rule = schema.rule(*known);
+		if (!rule.accepted) {
+			values.resize(arg.firstValue);
+			numbers.resize(arg.firstValue);
+			args.pop_back();
+			return;
+		}
+
+		arg.known = *known;
+		for (auto &number : std::span(numbers).subspan(arg.firstValue, arg.valueCount))
+			if (number) *number = std::clamp(*number, rule.min, rule.max);
+		group.knownArgs[std::to_underlying(*known)] = static_cast<std::uint32_t>(args.size() - 1);
+	}
+};
+
+// Returns the command part of a chat message ("!cmd<args> text" -> "cmd"), without allocating
+// @return empty view if message is not a command
+export auto extract_command(std::string_view message) -> std::string_view {
+	if (!message.starts_with('!')) return {};
+	message.remove_prefix(1);
+	message = message.substr(0, message.find_first_of(" <"));
+	while (!message.empty() && std::isspace(static_cast<unsigned char>(message.front())))
+		message.remove_prefix(1);
+	while (!message.empty() && std::isspace(static_cast<unsigned char>(message.back())))
+		message.remove_suffix(1);
+	return message;
+}
+
+// Returns span of part within whole, part must be a view into whole
+constexpr auto span_of(const std::string_view whole, const std::string_view part) -> TextSpan {
+	return {static_cast<std::uint32_t>(part.data() - whole.data()),
+			static_cast<std::uint32_t>(part.size())};
+}
+
+// Parses argument list of a group, "key=value1|value2,key2=value3"
+// entries without exactly one '=' are skipped
+void parse_group_args(ParsedMessage &parsed, ParsedGroup &group, const ArgSchema &schema,
+					  const std::string_view source, std::string_view argList) {
+	while (true) {
+		const auto comma = argList.find(',');
+		const auto entry = argList.substr(0, comma);
+
+		if (const auto eq = entry.find('=');
+			eq != std::string_view::npos && entry.find('=', eq + 1) == std::string_view::npos) {
+			auto &arg = parsed.args.emplace_back();
+			arg.key = span_of(source, entry.substr(0, eq));
+			arg.firstValue = static_cast<std::uint32_t>(parsed.values.size());
+
+			auto valueList = entry.substr(eq + 1);
+			while (true) {
+				const auto bar = valueList.find('|');
+				parsed.add_value(span_of(source, valueList.substr(0, bar)));
+				if (bar == std::string_view::npos) break;
+				valueList.remove_prefix(bar + 1);
+			}
+			arg.valueCount = static_cast<std::uint32_t>(parsed.values.size()) - arg.firstValue;
+			parsed.finish_arg(group, schema);
+		}
+
+		if (comma == std::string_view::npos) break;
+		argList.remove_prefix(comma + 1);
+	}
+}
+
+// Parses chat message in a single pass, copying it into the arena of parsed without tabs
+// schema is of the command message calls, validating and clamping its arguments
+export void parse_chat_message(ParsedMessage &parsed, const std::string_view message,
+							   const ArgSchema &schema = ArgSchema::make_default()) {
+	parsed.source.reserve(message.size());
+	std::ranges::copy_if(message, std::back_inserter(parsed.source),
+						 [](const char ch) { return ch != '\t'; });
+	parsed.reserve(parsed.source);
+	const auto source = std::string_view(parsed.source);
+	parsed.message = span_of(source, source);
+	parsed.text = parsed.message;
+	if (!source.starts_with('!')) return;
+
+	parsed.isCommand = true;
+
+	if (const auto command = extract_command(source); !command.empty()) {
+		parsed.command = span_of(source, command);
+		parsed.text = span_of(source, source.substr(command.data() + command.size() -
+													source.data()));
+	}
+
+	// Each "<...>" is a group, its text runs until the next '<'
+	auto groupStart = source.find('<');
+	while (groupStart != std::string_view::npos) {
+		const auto groupEnd = source.find('>', groupStart + 1);
+		if (groupEnd == std::string_view::npos) break;
+
+		auto &group = parsed.groups.emplace_back();
+		group.firstArg = static_cast<std::uint32_t>(parsed.args.size());
+		parse_group_args(parsed, group, schema, source,
+						 source.substr(groupStart + 1, groupEnd - groupStart - 1));
+		group.argCount = static_cast<std::uint32_t>(parsed.args.size()) - group.firstArg;
+
+		groupStart = source.find('<', groupEnd);
+		const auto textEnd = groupStart == std::string_view::npos ? source.size() : groupStart;
+		group.text = span_of(source, source.substr(groupEnd + 1, textEnd - groupEnd - 1));
+	}
+}
+
+// Builds parsed message out of already separated parts, storing them after the message
+// args become the single group, with message as its text
+export void make_parsed_message(ParsedMessage &parsed, const std::string_view message,
+								const std::string_view command,
+								const std::map<std::string, std::vector<std::string>> &args,
+								const ArgSchema &schema = ArgSchema::make_default()) {
+	std::size_t argValueCount = 0, sourceSize = message.size() + command.size();
+	for (const auto &[key, values] : args) {
+		argValueCount += values.size();
+		sourceSize += key.size();
+		for (const auto &value : values) sourceSize += value.size();
+	}
+	parsed.source.reserve(sourceSize);
+	parsed.groups.reserve(1);
+	parsed.args.reserve(args.size());
+	parsed.values.reserve(argValueCount);
+	parsed.numbers.reserve(argValueCount);
+	const auto append = [&parsed](const std::string_view str) {
+		const auto span = TextSpan{static_cast<std::uint32_t>(parsed.source.size()),
+								   static_cast<std::uint32_t>(str.size())};
+		parsed.source += str;
+		return span;
+	};
+
+	parsed.message = append(message);
+	parsed.text = parsed.message;
+	parsed.command = append(command);
+	parsed.isCommand = !command.empty() || message.starts_with('!');
+
+	auto &group = parsed.groups.emplace_back();
+	group.text = parsed.message;
+	for (const auto &[key, values] : args) {
+		auto &arg = parsed.args.emplace_back();
+		arg.key = append(key);
+		arg.firstValue = static_cast<std::uint32_t>(parsed.values.size());
+		for (const auto &value : values) parsed.add_value(append(value));
+		arg.valueCount = static_cast<std::uint32_t>(values.size());
+		parsed.finish_arg(group, schema);
+	}
+	group.argCount = static_cast<std::uint32_t>(parsed.args.size());
+}
@@ -35,6 +35,7 @@ import notification;
 import twitch;
 import commands;
 import scripting;
+import admission;
 
 // Class which manages the GUI + notifications
 export class NotifierGUI {
@@ -47,6 +48,15 @@ export class NotifierGUI {
 	static inline std::vector<std::unique_ptr<Notification>> m_notifications;
 	static inline std::mutex m_notifMutex;
 
+	// Notification waiting for a free slot
+	struct PendingNotification {
+		std::string text;
+		TwitchChatMessage msg;
+		std::shared_ptr<const AsciiArt> art;
+	};
+	// Caps live notifications, ones over it wait or get shed
+	static inline AdmissionGate<PendingNotification> m_admission;
+
 	static inline auto m_colorOK = ImVec4(0.0f, 0.8f, 0.0f, 1.0f);
 	static inline auto m_colorError = ImVec4(0.8f, 0.0f, 0.0f, 1.0f);
 	static inline auto m_colorWait = ImVec4(0.8f, 0.4f, 0.0f, 1.0f);
@@ -63,9 +73,9 @@ public:
 
 		// MAIN WINDOW IMGUI INITIALIZATION //
 		if (!ImGui_ImplGlfw_InitForOpenGL(OpenGLHandler::get_main_window(), false))
-			return Result(6, "Failed to initialize ImGui GLFW backend!");
+			return fail(ErrorCode::eGui, "Failed to initialize ImGui GLFW backend!");
 		if (!ImGui_ImplGlad_Init("#version 330 core"))
-			return Result(7, "Failed to initialize ImGui glad backend!");
+			return fail(ErrorCode::eGui, "Failed to initialize ImGui glad backend!");
 
 		// Calculate pixel density
 		// (DPI = (square root of (horizontal pixels² + vertical pixels²)) / diagonal screen size in
@@ -85,7 +95,7 @@ public:
 			io.FontDefault = m_mainFont;
 		} else {
 			// We require this font
-			return Result(5, "Main font NotoSansMono.ttf not found!");
+			return fail(ErrorCode::eMissingAsset, "Main font NotoSansMono.ttf not found!");
 		}
 
 		// NotoSansSymbols2.ttf for notifications
@@ -159,8 +169,8 @@ public:
 			ImGui::SameLine();
 			ImGui::BeginDisabled(!it->second.enabled);
 			if (ImGui::Button("Test"))
-				CommandHandler::execute_command(it->first,
-												TwitchChatMessage("testButton", testMsg));
+				CommandHandler::execute_command(
+					it->first, TwitchChatMessage("testButton", testMsg, it->second.schema));
 
 			ImGui::EndDisabled();
 
@@ -190,8 +200,14 @@ public:
 			// Lock mutex for notifications
 			std::scoped_lock lock(m_notifMutex);
 
-			// Remove notifications that have lived their lifetime
-			std::erase_if(m_notifications, [](const auto &notif) { return notif->is_dead(); });
+			// Remove notifications that have lived their lifetime, letting waiting ones in
+			if (const auto removed = std::erase_if(
+					m_notifications, [](const auto &notif) { return notif->is_dead(); });
+				removed > 0) {
+				for (const auto &pending : m_admission.release(removed))
+					m_notifications.emplace_back(
+						std::make_unique<Notification>(pending.text, pending.msg, pending.art));
+			}
 
 			// Render notifications
 			for (const auto &notif : m_notifications) notif->render(m_notifFont);
@@ -203,12 +219,23 @@ public:
 	}
 
 	// Method for launching new notification
-	static void launch_notification(const std::string &notifStr, const TwitchChatMessage &msg) {
+	// goes through admission, so it may be shown later or not at all under load
+	static void launch_notification(const std::string &notifStr, const TwitchChatMessage &msg,
+									const std::shared_ptr<const AsciiArt> &art) {
+		m_admission.set_limits(global_config.maxNotifications.value,
+							   global_config.admissionQueue.value, global_config.admissionPolicy);
+		const auto admitted = m_admission.offer({notifStr, msg, art}, msg.priority);
+		if (!admitted) return;
+
 		// Lock mutex for notifications
 		std::scoped_lock lock(m_notifMutex);
-		m_notifications.emplace_back(std::make_unique<Notification>(notifStr, msg));
+		m_notifications.emplace_back(
+			std::make_unique<Notification>(admitted->text, admitted->msg, admitted->art));
 	}
 
+	// Returns counters of notification admission
+	static auto get_admission_stats() -> AdmissionStats { return m_admission.get_stats(); }
+
 private:
 	// Returns string depending on connection status and result
 	static auto get_connection_status_string(const ConnectionStatus status, const Result &res)
@@ -221,7 +248,7 @@ private:
 		case ConnectionStatus::eDisconnected:
 			return "Disconnected";
 		default:
-			return std::format("Error: {}", res.message);
+			return std::format("Error: {}", res ? "" : res.error().describe());
 		}
 	}
 
@@ -0,0 +1,111 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module irc;
+
+import standard;
+
+// Enum class of IRC commands we care about, everything else is eUnknown
+export enum class IRCCommand {
+	eUnknown,
+	ePass,
+	eNick,
+	eJoin,
+	ePing,
+	ePong,
+	eWelcome,
+	eNotice,
+	ePrivmsg,
+	eReconnect
+};
+
+// Returns IRCCommand matching given command verb
+export constexpr auto parse_irc_command(const std::string_view verb) -> IRCCommand {
+	switch (verb.size()) {
+	case 3:
+		if (verb == "001") return IRCCommand::eWelcome;
+		break;
+	case 4:
+		if (verb == "PING") return IRCCommand::ePing;
+		if (verb == "PONG") return IRCCommand::ePong;
+		if (verb == "PASS") return IRCCommand::ePass;
+		if (verb == "NICK") return IRCCommand::eNick;
+		if (verb == "JOIN") return IRCCommand::eJoin;
+		break;
+	case 6:
+		if (verb == "NOTICE") return IRCCommand::eNotice;
+		break;
+	case 7:
+		if (verb == "PRIVMSG") return IRCCommand::ePrivmsg;
+		break;
+	case 9:
+		if (verb == "RECONNECT") return IRCCommand::eReconnect;
+		break;
+	default:
+		break;
+	}
+	return IRCCommand::eUnknown;
+}
+
+// Tokenized IRC line, every view points into the line it was parsed from
+// "@tags :prefix VERB param1 param2 :trailing text"
+export struct IRCMessage {
+	std::string_view tags, prefix, verb, params, trailing;
+	IRCCommand command = IRCCommand::eUnknown;
+
+	// Returns the nickname part of the prefix ("nick!user@host" -> "nick")
+	[[nodiscard]] constexpr auto get_nick() const -> std::string_view {
+		return prefix.substr(0, prefix.find('!'));
+	}
+};
+
+// Parses single IRC line in one pass, without allocating
+// anything after the first CR or LF is ignored
+// @return parsed message, or nullopt if line has no command verb
+export constexpr auto parse_irc_line(std::string_view line) -> std::optional<IRCMessage> {
+	if (const auto eol = line.find_first_of("\r\n"); eol != std::string_view::npos)
+		line = line.substr(0, eol);
+
+	// Splits off the next space-separated token from line
+	const auto next_token = [&line] {
+		const auto space = line.find(' ');
+		const auto token = line.substr(0, space);
+		line = space == std::string_view::npos ? std::string_view{} : line.substr(space + 1);
+		while (line.starts_with(' ')) line.remove_prefix(1);
+		return token;
+	};
+
+	IRCMessage msg;
+	if (line.starts_with('@')) msg.tags = next_token().substr(1);
+	if (line.starts_with(':')) msg.prefix = next_token().substr(1);
+
+	msg.verb = next_token();
+	if (msg.verb.empty()) return std::nullopt;
+	msg.command = parse_irc_command(msg.verb);
+
+	// Trailing is everything after the first " :" once we're past the verb
+	if (line.starts_with(':')) {
+		msg.trailing = line.substr(1);
+	} else if (const auto trailingPos = line.find(" :"); trailingPos != std::string_view::npos) {
+		msg.params = line.substr(0, trailingPos);
+		msg.trailing = line.substr(trailingPos + 2);
+	} else {
+		msg.params = line;
+	}
+
+	return msg;
+}
+
+// Pops the next line off the front of a frame, without its CR/LF terminator
+// empty lines are skipped, returns empty view once frame is exhausted
+export constexpr auto next_irc_line(std::string_view &frame) -> std::string_view {
+	while (!frame.empty()) {
+		const auto eol = frame.find_first_of("\r\n");
+		const auto line = frame.substr(0, eol);
+		frame = eol == std::string_view::npos ? std::string_view{} : frame.substr(eol + 1);
+		if (!line.empty()) return line;
+	}
+	return {};
+}
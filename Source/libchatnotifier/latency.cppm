@@ -0,0 +1,215 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module latency;
+
+import standard;
+
+// Points a chat message passes on its way from the socket to the screen and speakers
+export enum class LatencyStage : std::uint8_t {
+	eFrameReceived,		  //< WebSocket frame arrived, origin of every trace
+	eParsed,			  //< IRC lines of the frame tokenized
+	eAdmitted,			  //< Passed cooldowns, queued for dispatch
+	eExecuted,			  //< Command function started on the dispatcher thread
+	eNotificationCreated, //< Notification constructed
+	eFirstRender,		  //< Notification drawn for the first time
+	eAudioStart,		  //< alSourcePlay called for the first sound
+	eCount
+};
+
+// Stage each stage is measured from, audio follows the command rather than the notification
+constexpr std::array<LatencyStage, std::to_underlying(LatencyStage::eCount)> stage_previous = {
+	LatencyStage::eFrameReceived,		// eFrameReceived
+	LatencyStage::eFrameReceived,		// eParsed
+	LatencyStage::eParsed,				// eAdmitted
+	LatencyStage::eAdmitted,			// eExecuted
+	LatencyStage::eExecuted,			// eNotificationCreated
+	LatencyStage::eNotificationCreated,	// eFirstRender
+	LatencyStage::eExecuted};			// eAudioStart
+
+export constexpr auto get_latency_stage_name(const LatencyStage stage) -> std::string_view {
+	constexpr std::array<std::string_view, std::to_underlying(LatencyStage::eCount)> names = {
+		"frame_received",		"parsed",		"admitted",	   "executed",
+		"notification_created", "first_render", "audio_start"};
+	return names[std::to_underlying(stage)];
+}
+
+// Log-linear histogram of microsecond values, HDR style, safe to record into from any thread
+// every power of two is split into 32 linear sub-buckets, keeping error under ~3%
+export class LatencyHistogram {
+	static constexpr unsigned sub_bits = 5;
+	static constexpr std::uint64_t sub_count = 1u << sub_bits;
+	// Values are clamped to 2^36us, about 19 hours
+	static constexpr unsigned max_bits = 36;
+	static constexpr std::size_t bucket_count = (max_bits - sub_bits + 1) * sub_count;
+
+	std::array<std::atomic<std::uint64_t>, bucket_count> m_buckets{};
+	std::atomic<std::uint64_t> m_count = 0, m_sum = 0, m_max = 0;
+
+public:
+	void record(std::uint64_t valueUs) {
+		valueUs = std::min(valueUs, (std::uint64_t{1} << max_bits) - 1);
+		m_buckets[bucket_index(valueUs)].fetch_add(1, std::memory_order_relaxed);
+		m_count.fetch_add(1, std::memory_order_relaxed);
+		m_sum.fetch_add(valueUs, std::memory_order_relaxed);
+
+		auto max = m_max.load(std::memory_order_relaxed);
+		while (valueUs > max &&
+			   !m_max.compare_exchange_weak(max, valueUs, std::memory_order_relaxed)) {}
+	}
+
+	// Returns value at given percentile (0-100), upper bound of the bucket it falls in
+	[[nodiscard]] auto percentile(const double pct) const -> std::uint64_t {
+		const auto count = m_count.load(std::memory_order_relaxed);
+		if (count == 0) return 0;
+
+		const auto target = std::max<std::uint64_t>(
+			1, static_cast<std::uint64_t>(std::ceil(static_cast<double>(count) * pct / 100.0)));
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < bucket_count; ++i) {
+			seen += m_buckets[i].load(std::memory_order_relaxed);
+			if (seen >= target)
+				return std::min(bucket_upper(i), m_max.load(std::memory_order_relaxed));
+		}
+		return m_max.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] auto count() const -> std::uint64_t {
+		return m_count.load(std::memory_order_relaxed);
+	}
+	[[nodiscard]] auto max() const -> std::uint64_t {
+		return m_max.load(std::memory_order_relaxed);
+	}
+	[[nodiscard]] auto mean() const -> double {
+		const auto count = m_count.load(std::memory_order_relaxed);
+		return count ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) / count : 0.0;
+	}
+
+	void reset() {
+		for (auto &bucket : m_buckets) bucket.store(0, std::memory_order_relaxed);
+		m_count = 0;
+		m_sum = 0;
+		m_max = 0;
+	}
+
+private:
+	static constexpr auto bucket_index(const std::uint64_t value) -> std::size_t {
+		if (value < sub_count) return value;
+		const auto shift = std::bit_width(value) - sub_bits - 1;
+		return (shift + 1) * sub_count + ((value >> shift) - sub_count);
+	}
+
+	static constexpr auto bucket_upper(const std::size_t index) -> std::uint64_t {
+		if (index < sub_count) return index;
+		const auto shift = index / sub_count - 1;
+		return ((index % sub_count + sub_count + 1) << shift) - 1;
+	}
+};
+
+// Timestamps of a single message, shared between every copy and submessage of it
+// each stage keeps the first time it was marked, later marks are ignored
+export class MessageTrace {
+	std::uint64_t m_id;
+	std::array<std::atomic<std::int64_t>, std::to_underlying(LatencyStage::eCount)> m_stamps{};
+
+public:
+	MessageTrace(const std::uint64_t id,
+				 const std::chrono::time_point<std::chrono::steady_clock> received)
+		: m_id(id) {
+		m_stamps[0] = received.time_since_epoch().count();
+	}
+
+	// Marks stage as reached, recording its latency if this is the first time
+	void mark(LatencyStage stage, std::chrono::time_point<std::chrono::steady_clock> when =
+									  std::chrono::steady_clock::now());
+
+	[[nodiscard]] auto get_id() const -> std::uint64_t { return m_id; }
+
+	// Returns time stage was reached, nullopt if it hasn't been
+	[[nodiscard]] auto get_stamp(const LatencyStage stage) const
+		-> std::optional<std::chrono::time_point<std::chrono::steady_clock>> {
+		const auto stamp = m_stamps[std::to_underlying(stage)].load(std::memory_order_acquire);
+		if (stamp == 0) return std::nullopt;
+		return std::chrono::time_point<std::chrono::steady_clock>(
+			std::chrono::steady_clock::duration(stamp));
+	}
+
+private:
+	friend class LatencyTracker;
+	auto set_stamp(const LatencyStage stage, const std::int64_t stamp) -> bool {
+		std::int64_t expected = 0;
+		return m_stamps[std::to_underlying(stage)].compare_exchange_strong(
+			expected, stamp, std::memory_order_acq_rel);
+	}
+};
+
+// Latency percentiles of a stage, in microseconds
+export struct LatencyStageStats {
+	std::string_view name;
+	std::uint64_t count = 0, p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+	double mean = 0.0;
+	// Same, measured from frame received instead of the previous stage
+	std::uint64_t totalP50 = 0, totalP99 = 0, totalMax = 0;
+};
+
+// Class for handing out traces and aggregating their stage latencies
+export class LatencyTracker {
+	static constexpr auto stage_count = std::to_underlying(LatencyStage::eCount);
+
+	static inline std::atomic<std::uint64_t> m_nextId = 1;
+	// Latency from previous stage, and from frame received
+	static inline std::array<LatencyHistogram, stage_count> m_stageHistograms;
+	static inline std::array<LatencyHistogram, stage_count> m_totalHistograms;
+
+public:
+	// Starts trace for message whose frame was received at given time
+	static auto new_trace(const std::chrono::time_point<std::chrono::steady_clock> received)
+		-> std::shared_ptr<MessageTrace> {
+		return std::make_shared<MessageTrace>(m_nextId.fetch_add(1, std::memory_order_relaxed),
+											  received);
+	}
+
+	// Returns stats of every stage after frame received
+	static auto get_stats() -> std::vector<LatencyStageStats> {
+		std::vector<LatencyStageStats> stats;
+		for (std::size_t i = 1; i < stage_count; ++i) {
+			const auto &stage = m_stageHistograms[i];
+			const auto &total = m_totalHistograms[i];
+			stats.push_back({get_latency_stage_name(static_cast<LatencyStage>(i)), stage.count(),
+							 stage.percentile(50.0), stage.percentile(90.0),
+							 stage.percentile(99.0), stage.percentile(99.9), stage.max(),
+							 stage.mean(), total.percentile(50.0), total.percentile(99.0),
+							 total.max()});
+		}
+		return stats;
+	}
+
+	static void reset() {
+		for (auto &histogram : m_stageHistograms) histogram.reset();
+		for (auto &histogram : m_totalHistograms) histogram.reset();
+	}
+
+private:
+	friend class MessageTrace;
+	static void record(const MessageTrace &trace, const LatencyStage stage,
+					   const std::chrono::time_point<std::chrono::steady_clock> when) {
+		const auto to_us = [when](const auto from) -> std::uint64_t {
+			return std::max<std::int64_t>(
+				0, std::chrono::duration_cast<std::chrono::microseconds>(when - from).count());
+		};
+
+		const auto index = std::to_underlying(stage);
+		if (const auto previous = trace.get_stamp(stage_previous[index]))
+			m_stageHistograms[index].record(to_us(*previous));
+		if (const auto received = trace.get_stamp(LatencyStage::eFrameReceived))
+			m_totalHistograms[index].record(to_us(*received));
+	}
+};
+
+void MessageTrace::mark(const LatencyStage stage,
+						const std::chrono::time_point<std::chrono::steady_clock> when) {
+	if (set_stamp(stage, when.time_since_epoch().count()))
+		LatencyTracker::record(*this, stage, when);
+}
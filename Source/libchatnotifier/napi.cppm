@@ -34,39 +34,31 @@ import commands;
 import filesystem;
 import scripting;
 import runner;
+import queue;
+import latency;
+import coalesce;
+import admission;
+import rng;
 
 Runner main_runner;
 bool cn_initialized = false;
 
 void print_error(const Result &res) {
-	if (!res) std::println("Error: {}", res.message);
+	if (!res) std::println("Error: {}", res.error().describe());
 }
 
-void twc_callback_handler(const TwitchChatMessage &msg) {
-	// Check that the user is in the approvedUsers list, if empty just allow it
-	if (global_config.approvedUsers.empty() ||
-		std::ranges::any_of(global_config.approvedUsers, [&](const auto &user) {
-			return lowercase(user) == lowercase(msg.user);
-		})) {
-		// Check for command and execute
-		for (const auto &[key, command] : CommandHandler::get_commands_map()) {
-			const auto fullCommand = command.callstr;
-			if (fullCommand.empty()) continue;
-
-			// Make sure the message is long enough to contain the command
-			if (msg.message.size() < fullCommand.size()) continue;
-
-			// Extract the command from the message
-			auto extractedCommand = msg.get_command();
-
-			// If command is shorter than the extracted command, skip, prevents partial matches
-			if (fullCommand.size() < extractedCommand.size()) continue;
-
-			// Strict comparison of the command, to prevent partial matches
-			if (lowercase(extractedCommand).contains(fullCommand)) {
-				CommandHandler::execute_command(key, msg);
-				break;
-			}
+// Adds command for each script with on_message method, called from the Python thread
+void add_script_commands() {
+	for (const auto &script : ScriptingHandler::get_scripts()) {
+		if (script->has_method("on_message")) {
+			auto command = Command(script->get_call_string(), script->get_call_string(),
+								   [script](const TwitchChatMessage &msg) {
+									   ScriptingHandler::execute_script_method(
+										   script, "on_message", msg);
+								   });
+			command.priority = script->get_priority();
+			command.schema = script->get_arg_schema();
+			CommandHandler::add_command(script->get_name(), command);
 		}
 	}
 }
@@ -92,7 +84,7 @@ namespace libchatnotifier {
 		std::println("Filesystem with argc: {} and argv: {}", argc, argv[0]);
 		if (const auto res = Filesystem::initialize(argc, argv); !res) {
 			print_error(res);
-			return res.code;
+			return std::to_underlying(res.error().code);
 		}
 
 		// LOAD CONFIG //
@@ -106,25 +98,26 @@ namespace libchatnotifier {
 		std::println("ScriptingHandler initialize");
 		if (const auto res = ScriptingHandler::initialize(); !res) {
 			print_error(res);
-			return res.code;
+			return std::to_underlying(res.error().code);
 		}
 
 		std::println("AssetsHandler initialize");
 		if (const auto res = AssetsHandler::initialize(); !res) {
 			print_error(res);
-			return res.code;
+			return std::to_underlying(res.error().code);
 		}
 
 		std::println("AudioPlayer initialize");
 		if (const auto res = AudioPlayer::initialize(); !res) {
 			print_error(res);
-			return res.code;
+			return std::to_underlying(res.error().code);
 		}
 
 		std::println("TwitchChatConnector initialize");
-		if (const auto res = TwitchChatConnector::initialize(twc_callback_handler); !res) {
+		if (const auto res = TwitchChatConnector::initialize(CommandHandler::dispatch_message);
+			!res) {
 			print_error(res);
-			return res.code;
+			return std::to_underlying(res.error().code);
 		}
 
 		main_runner.add_job_sync([&]() -> void {
@@ -144,24 +137,12 @@ namespace libchatnotifier {
 		std::println("CommandHandler initialize");
 		if (const auto res = CommandHandler::initialize(NotifierGUI::launch_notification); !res) {
 			print_error(res);
-			return res.code;
+			return std::to_underlying(res.error().code);
 		}
 
 		// Add scripts
 		std::println("Add scripts");
-		ScriptingHandler::refresh_scripts([] {
-			for (const auto &script : ScriptingHandler::get_scripts()) {
-				if (script->has_method("on_message")) {
-					CommandHandler::add_command(
-						script->get_name(),
-						Command(script->get_call_string(), script->get_call_string(),
-								[script](const TwitchChatMessage &msg) {
-									ScriptingHandler::execute_script_method(script, "on_message",
-																			msg);
-								}));
-				}
-			}
-		});
+		ScriptingHandler::refresh_scripts(add_script_commands);
 
 		std::println("Initialized!");
 		cn_initialized = true;
@@ -213,7 +194,7 @@ namespace libchatnotifier {
 	auto save_config() -> int {
 		if (const auto res = global_config.save(); !res) {
 			print_error(res);
-			return res.code;
+			return std::to_underlying(res.error().code);
 		}
 		return 0;
 	}
@@ -283,6 +264,129 @@ namespace libchatnotifier {
 		return Napi::String::New(env, str);
 	}
 
+	Napi::Object chat_queue_statsWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		const auto stats = TwitchChatConnector::get_queue_stats();
+		auto obj = Napi::Object::New(env);
+		obj.Set("capacity", Napi::Number::New(env, static_cast<double>(stats.capacity)));
+		obj.Set("depth", Napi::Number::New(env, static_cast<double>(stats.depth)));
+		obj.Set("highWater", Napi::Number::New(env, static_cast<double>(stats.highWater)));
+		obj.Set("enqueued", Napi::Number::New(env, static_cast<double>(stats.enqueued)));
+		obj.Set("dequeued", Napi::Number::New(env, static_cast<double>(stats.dequeued)));
+		obj.Set("dropped", Napi::Number::New(env, static_cast<double>(stats.dropped)));
+		return obj;
+	}
+
+	Napi::Object admission_stats_object(const Napi::Env env, const AdmissionStats &stats) {
+		auto obj = Napi::Object::New(env);
+		obj.Set("cap", Napi::Number::New(env, static_cast<double>(stats.cap)));
+		obj.Set("active", Napi::Number::New(env, static_cast<double>(stats.active)));
+		obj.Set("waiting", Napi::Number::New(env, static_cast<double>(stats.waiting)));
+		obj.Set("admitted", Napi::Number::New(env, static_cast<double>(stats.admitted)));
+		obj.Set("queued", Napi::Number::New(env, static_cast<double>(stats.queued)));
+		obj.Set("shed", Napi::Number::New(env, static_cast<double>(stats.shed)));
+		return obj;
+	}
+	// Sounds are counted in OpenAL sources
+	Napi::Object admission_statsWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		auto obj = Napi::Object::New(env);
+		obj.Set("notifications",
+				admission_stats_object(env, NotifierGUI::get_admission_stats()));
+		obj.Set("sounds", admission_stats_object(env, AudioPlayer::get_admission_stats()));
+		return obj;
+	}
+
+	Napi::Object source_pool_statsWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		const auto stats = AudioPlayer::get_source_pool_stats();
+		auto obj = Napi::Object::New(env);
+		obj.Set("size", Napi::Number::New(env, static_cast<double>(stats.size)));
+		obj.Set("inUse", Napi::Number::New(env, static_cast<double>(stats.inUse)));
+		obj.Set("highWater", Napi::Number::New(env, static_cast<double>(stats.highWater)));
+		obj.Set("acquired", Napi::Number::New(env, static_cast<double>(stats.acquired)));
+		obj.Set("stolen", Napi::Number::New(env, static_cast<double>(stats.stolen)));
+		obj.Set("exhausted", Napi::Number::New(env, static_cast<double>(stats.exhausted)));
+		return obj;
+	}
+
+	// Sizes are in bytes
+	Napi::Object sound_bank_statsWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		const auto stats = AudioPlayer::get_sound_bank_stats();
+		auto obj = Napi::Object::New(env);
+		obj.Set("sounds", Napi::Number::New(env, static_cast<double>(stats.sounds)));
+		obj.Set("bytes", Napi::Number::New(env, static_cast<double>(stats.bytes)));
+		obj.Set("budget", Napi::Number::New(env, static_cast<double>(stats.budget)));
+		obj.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+		obj.Set("misses", Napi::Number::New(env, static_cast<double>(stats.misses)));
+		obj.Set("evictions", Napi::Number::New(env, static_cast<double>(stats.evictions)));
+		return obj;
+	}
+
+	Napi::Object coalesce_statsWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		const auto stats = CommandCoalescer::get_stats();
+		auto obj = Napi::Object::New(env);
+		obj.Set("groups", Napi::Number::New(env, static_cast<double>(stats.groups)));
+		obj.Set("absorbed", Napi::Number::New(env, static_cast<double>(stats.absorbed)));
+		return obj;
+	}
+
+	// Latencies are in microseconds, keyed by stage name
+	Napi::Object latency_statsWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		auto obj = Napi::Object::New(env);
+		for (const auto &stats : LatencyTracker::get_stats()) {
+			auto stageObj = Napi::Object::New(env);
+			stageObj.Set("count", Napi::Number::New(env, static_cast<double>(stats.count)));
+			stageObj.Set("mean", Napi::Number::New(env, stats.mean));
+			stageObj.Set("p50", Napi::Number::New(env, static_cast<double>(stats.p50)));
+			stageObj.Set("p90", Napi::Number::New(env, static_cast<double>(stats.p90)));
+			stageObj.Set("p99", Napi::Number::New(env, static_cast<double>(stats.p99)));
+			stageObj.Set("p999", Napi::Number::New(env, static_cast<double>(stats.p999)));
+			stageObj.Set("max", Napi::Number::New(env, static_cast<double>(stats.max)));
+			stageObj.Set("totalP50", Napi::Number::New(env, static_cast<double>(stats.totalP50)));
+			stageObj.Set("totalP99", Napi::Number::New(env, static_cast<double>(stats.totalP99)));
+			stageObj.Set("totalMax", Napi::Number::New(env, static_cast<double>(stats.totalMax)));
+			obj.Set(std::string(stats.name), stageObj);
+		}
+		return obj;
+	}
+	Napi::Value reset_latency_statsWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		LatencyTracker::reset();
+		return env.Undefined();
+	}
+
+	// Seeds random numbers for reproducible runs, no argument or 0 goes back to random seeding
+	Napi::Value set_random_seedWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		std::uint64_t seed = 0;
+		if (info.Length() >= 1 && info[0].IsNumber())
+			seed = static_cast<std::uint64_t>(info[0].As<Napi::Number>().Int64Value());
+		RandomHandler::set_seed(seed);
+		return env.Undefined();
+	}
+
+	Napi::Boolean start_captureWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		if (info.Length() >= 1 && info[0].IsString()) {
+			const auto path = info[0].As<Napi::String>().Utf8Value();
+			if (const auto res = TwitchChatConnector::start_capture(path); !res) {
+				print_error(res);
+				return Napi::Boolean::New(env, false);
+			}
+			return Napi::Boolean::New(env, true);
+		}
+		return Napi::Boolean::New(env, false);
+	}
+	Napi::Boolean stop_captureWrapped(const Napi::CallbackInfo &info) {
+		const auto env = info.Env();
+		TwitchChatConnector::stop_capture();
+		return Napi::Boolean::New(env, true);
+	}
+
 	Napi::Value stop_all_soundsWrapped(const Napi::CallbackInfo &info) {
 		const auto env = info.Env();
 		AudioPlayer::stop_sounds();
@@ -292,24 +396,13 @@ namespace libchatnotifier {
 	Napi::Value find_new_assetsWrapped(const Napi::CallbackInfo &info) {
 		const auto env = info.Env();
 		AssetsHandler::refresh();
+		AudioPlayer::refresh_sounds();
 		return env.Undefined();
 	}
 
 	Napi::Value reload_scriptsWrapped(const Napi::CallbackInfo &info) {
 		const auto env = info.Env();
-		ScriptingHandler::refresh_scripts([] {
-			for (const auto &script : ScriptingHandler::get_scripts()) {
-				if (script->has_method("on_message")) {
-					CommandHandler::add_command(
-						script->get_name(),
-						Command(script->get_call_string(), script->get_call_string(),
-								[script](const TwitchChatMessage &msg) {
-									ScriptingHandler::execute_script_method(script, "on_message",
-																			msg);
-								}));
-				}
-			}
-		});
+		ScriptingHandler::refresh_scripts(add_script_commands);
 		return env.Undefined();
 	}
 
@@ -325,6 +418,16 @@ namespace libchatnotifier {
 		exports.Set("initialized", Napi::Function::New(env, initializedWrapped));
 		exports.Set("get_twitch_connection_status",
 					Napi::Function::New(env, twitch_connection_statusWrapped));
+		exports.Set("get_chat_queue_stats", Napi::Function::New(env, chat_queue_statsWrapped));
+		exports.Set("get_admission_stats", Napi::Function::New(env, admission_statsWrapped));
+		exports.Set("get_source_pool_stats", Napi::Function::New(env, source_pool_statsWrapped));
+		exports.Set("get_sound_bank_stats", Napi::Function::New(env, sound_bank_statsWrapped));
+		exports.Set("get_coalesce_stats", Napi::Function::New(env, coalesce_statsWrapped));
+		exports.Set("get_latency_stats", Napi::Function::New(env, latency_statsWrapped));
+		exports.Set("reset_latency_stats", Napi::Function::New(env, reset_latency_statsWrapped));
+		exports.Set("set_random_seed", Napi::Function::New(env, set_random_seedWrapped));
+		exports.Set("start_capture", Napi::Function::New(env, start_captureWrapped));
+		exports.Set("stop_capture", Napi::Function::New(env, stop_captureWrapped));
 		exports.Set("stop_all_sounds", Napi::Function::New(env, stop_all_soundsWrapped));
 		exports.Set("find_new_assets", Napi::Function::New(env, find_new_assetsWrapped));
 		exports.Set("reload_scripts", Napi::Function::New(env, reload_scriptsWrapped));
@@ -18,6 +18,10 @@ import common;
 import effect;
 import config;
 import opengl;
+import latency;
+import coalesce;
+import assets;
+import utf8;
 
 // Class for notifications
 export class Notification {
@@ -25,28 +29,32 @@ export class Notification {
 	float m_lifetime = 0.0f;
 	const float m_maxLifetime;
 	TextEffectMix m_effectMix;
+	std::shared_ptr<MessageTrace> m_trace; //< Released once first frame is rendered
+	RepeatCounter m_repeats;			   //< Identical messages folded into this one
 
 public:
 	Notification() = delete;
 	~Notification() = default;
 
-	explicit Notification(const std::string &notifStr, const TwitchChatMessage &msg)
-		: m_fullText(notifStr), m_maxLifetime(global_config.notifAnimationLength.value) {
-		auto intensity = msg.get_command_arg<float>("intensity")
-							 .value_or(global_config.notifEffectIntensity.value);
-		intensity = std::clamp(intensity, global_config.notifEffectIntensity.min,
-							   global_config.notifEffectIntensity.max);
-		m_effectMix.setMixIntensity(intensity);
-
-		auto speed =
-			msg.get_command_arg<float>("speed").value_or(global_config.notifEffectSpeed.value);
-		speed = std::clamp(speed, global_config.notifEffectSpeed.min,
-						   global_config.notifEffectSpeed.max);
-		m_effectMix.setMixSpeed(speed);
-		m_effectMix.set_text(m_fullText);
-
-		if (const auto wantedEffects = msg.get_command_arg<std::vector<std::string>>("vfx");
-			wantedEffects) {
+	// Shows notifStr under art, if there is one
+	explicit Notification(const std::string &notifStr, const TwitchChatMessage &msg,
+						  const std::shared_ptr<const AsciiArt> &art = nullptr)
+		: m_fullText(notifStr), m_maxLifetime(global_config.notifAnimationLength.value),
+		  m_trace(msg.trace), m_repeats(msg.repeats) {
+		if (m_trace) m_trace->mark(LatencyStage::eNotificationCreated);
+
+		// Arguments were clamped into range when the message was parsed
+		m_effectMix.setMixIntensity(msg.get_command_arg<float>(ArgKey::eIntensity)
+										.value_or(global_config.notifEffectIntensity.value));
+		m_effectMix.setMixSpeed(msg.get_command_arg<float>(ArgKey::eSpeed)
+									.value_or(global_config.notifEffectSpeed.value));
+		// Lines of art were decoded when it was read, only the message is decoded here
+		m_effectMix.set_text(art ? std::span<const Utf8Line>(art->lines)
+								 : std::span<const Utf8Line>(),
+							 m_fullText);
+
+		if (const auto wantedEffects =
+				msg.get_command_arg<std::vector<std::string>>(ArgKey::eVfx)) {
 			for (const auto &effect : wantedEffects.value()) {
 				// Add effects
 				if (effect == "fade")
@@ -87,8 +95,28 @@ public:
 			m_effectMix.render(notifFont, timeT, TextEffectFlags::eCenteredHorizontal);
 		}
 
+		// Show how many identical messages were folded into this one, in the top right corner
+		if (const auto repeats = m_repeats ? m_repeats->load(std::memory_order_relaxed) : 1u;
+			repeats > 1) {
+			const auto label = std::format("x{}", repeats);
+			const auto font = notifFont ? notifFont : ImGui::GetFont();
+			const auto labelSize =
+				font->CalcTextSizeA(font->FontSize, FLT_MAX, 0.0f, label.c_str());
+			const auto windowPos = ImGui::GetWindowPos();
+			ImGui::GetWindowDrawList()->AddText(
+				font, font->FontSize,
+				ImVec2(windowPos.x + ImGui::GetWindowWidth() - labelSize.x - 16.0f,
+					   windowPos.y + 16.0f),
+				IM_COL32_WHITE, label.c_str());
+		}
+
 		ImGui::End();
 
+		if (m_trace) {
+			m_trace->mark(LatencyStage::eFirstRender);
+			m_trace.reset();
+		}
+
 		// Update times
 		m_lifetime += ImGui::GetIO().DeltaTime;
 	}
@@ -221,7 +221,7 @@ public:
 
 		// GLFW INITIALIZATION //
 		glfwSetErrorCallback(glfw_error_callback);
-		if (!glfwInit()) return Result(1, "Failed to initialize GLFW!");
+		if (!glfwInit()) return fail(ErrorCode::eWindow, "Failed to initialize GLFW!");
 
 		// WINDOW CREATION //
 		m_monitor = glfwGetPrimaryMonitor();
@@ -260,7 +260,8 @@ public:
 		// Main window
 		m_mainWindow = glfwCreateWindow(m_mode->width - 4, m_mode->height, "ChatNotifier Notifications",
 										nullptr, nullptr);
-		if (!m_mainWindow) return Result(2, "Failed to create ChatNotifier notifications window");
+		if (!m_mainWindow)
+			return fail(ErrorCode::eWindow, "Failed to create ChatNotifier notifications window");
 
 		glfwMakeContextCurrent(m_mainWindow);
 		glfwSwapInterval(1); // V-Sync
@@ -276,7 +277,7 @@ public:
 
 		// GLAD INITIALIZATION //
 		const auto version = gladLoadGL(glfwGetProcAddress);
-		if (version == 0) return Result(3, "Failed to initialize GLAD");
+		if (version == 0) return fail(ErrorCode::eWindow, "Failed to initialize GLAD");
 
 		// Print OpenGL version
 		std::println("OpenGL Version: {}.{}", GLAD_VERSION_MAJOR(version),
@@ -0,0 +1,143 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module queue;
+
+import standard;
+
+// Policy for what to do when pushing into a full queue
+export enum class QueueOverflowPolicy : std::uint8_t { eDropNewest, eDropOldest, eBlock };
+
+// Snapshot of queue counters, dequeued also counts entries discarded by eDropOldest
+export struct QueueStats {
+	std::size_t capacity = 0, depth = 0, highWater = 0;
+	std::uint64_t enqueued = 0, dequeued = 0, dropped = 0;
+};
+
+// Bounded lock-free multi-producer multi-consumer ring buffer
+// each slot carries a sequence number telling whether it's ready for push or pop
+export template <typename T>
+class BoundedQueue {
+	struct Slot {
+		std::atomic<std::size_t> sequence;
+		std::optional<T> value;
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	std::size_t m_mask;
+
+	alignas(64) std::atomic<std::size_t> m_enqueuePos = 0;
+	alignas(64) std::atomic<std::size_t> m_dequeuePos = 0;
+
+	// Counters, only for reporting
+	alignas(64) std::atomic<std::uint64_t> m_dropped = 0;
+	std::atomic<std::size_t> m_highWater = 0;
+
+public:
+	// Capacity is rounded up to next power of two
+	explicit BoundedQueue(const std::size_t capacity)
+		: m_slots(std::make_unique<Slot[]>(std::bit_ceil(std::max<std::size_t>(capacity, 2)))),
+		  m_mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1) {
+		for (std::size_t i = 0; i <= m_mask; ++i)
+			m_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	BoundedQueue(const BoundedQueue &) = delete;
+	auto operator=(const BoundedQueue &) -> BoundedQueue & = delete;
+
+	// Attempts to push value, leaving it untouched if queue is full
+	auto try_push(T &&value) -> bool {
+		auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+		Slot *slot = nullptr;
+		while (true) {
+			slot = &m_slots[pos & m_mask];
+			const auto seq = slot->sequence.load(std::memory_order_acquire);
+			if (const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+				diff == 0) {
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0)
+				return false;
+			else
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+		}
+
+		slot->value.emplace(std::move(value));
+		slot->sequence.store(pos + 1, std::memory_order_release);
+
+		// Track deepest the queue has been
+		const auto depth = pos + 1 - m_dequeuePos.load(std::memory_order_relaxed);
+		auto highWater = m_highWater.load(std::memory_order_relaxed);
+		while (depth > highWater &&
+			   !m_highWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed)) {}
+
+		return true;
+	}
+
+	// Pushes value, applying given policy if queue is full
+	// @return false if the pushed value was dropped
+	auto push(T &&value, const QueueOverflowPolicy policy) -> bool {
+		while (!try_push(std::move(value))) {
+			switch (policy) {
+			case QueueOverflowPolicy::eDropOldest:
+				// Make room by discarding the oldest entry, then retry
+				if (try_pop()) m_dropped.fetch_add(1, std::memory_order_relaxed);
+				break;
+			case QueueOverflowPolicy::eBlock:
+				std::this_thread::yield();
+				break;
+			case QueueOverflowPolicy::eDropNewest:
+			default:
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Attempts to pop oldest value
+	auto try_pop() -> std::optional<T> {
+		auto pos = m_dequeuePos.load(std::memory_order_relaxed);
+		Slot *slot = nullptr;
+		while (true) {
+			slot = &m_slots[pos & m_mask];
+			const auto seq = slot->sequence.load(std::memory_order_acquire);
+			if (const auto diff =
+					static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+				diff == 0) {
+				if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0)
+				return std::nullopt;
+			else
+				pos = m_dequeuePos.load(std::memory_order_relaxed);
+		}
+
+		auto value = std::move(slot->value);
+		slot->value.reset();
+		slot->sequence.store(pos + m_mask + 1, std::memory_order_release);
+		return value;
+	}
+
+	[[nodiscard]] auto capacity() const -> std::size_t { return m_mask + 1; }
+
+	// Approximate number of queued values
+	[[nodiscard]] auto depth() const -> std::size_t {
+		const auto enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+		const auto dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+		return enqueued > dequeued ? enqueued - dequeued : 0;
+	}
+
+	[[nodiscard]] auto get_stats() const -> QueueStats {
+		const auto enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+		const auto dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+		return {capacity(),
+				enqueued > dequeued ? enqueued - dequeued : 0,
+				m_highWater.load(std::memory_order_relaxed),
+				enqueued,
+				dequeued,
+				m_dropped.load(std::memory_order_relaxed)};
+	}
+};
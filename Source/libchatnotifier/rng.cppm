@@ -0,0 +1,126 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module rng;
+
+import standard;
+
+// SplitMix64 step, spreads seeds so similar ones still give unrelated states
+constexpr auto splitmix64(std::uint64_t &state) -> std::uint64_t {
+	auto z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// xoshiro256** generator, small and fast with the same output on every platform
+// usable with <random> distributions, though those differ between standard libraries
+export class Xoshiro256 {
+	std::array<std::uint64_t, 4> m_state{};
+
+public:
+	using result_type = std::uint64_t;
+
+	constexpr explicit Xoshiro256(std::uint64_t seed = 0) {
+		for (auto &word : m_state) word = splitmix64(seed);
+	}
+
+	static constexpr auto min() -> result_type { return 0; }
+	static constexpr auto max() -> result_type { return std::numeric_limits<result_type>::max(); }
+
+	constexpr auto operator()() -> result_type {
+		const auto result = std::rotl(m_state[1] * 5, 7) * 9;
+		const auto t = m_state[1] << 17;
+		m_state[2] ^= m_state[0];
+		m_state[3] ^= m_state[1];
+		m_state[1] ^= m_state[2];
+		m_state[0] ^= m_state[3];
+		m_state[2] ^= t;
+		m_state[3] = std::rotl(m_state[3], 45);
+		return result;
+	}
+
+	// Returns integer in [min, max], Lemire's multiply-shift with rejection so it's unbiased
+	constexpr auto next_int(const std::int32_t min, const std::int32_t max) -> std::int32_t {
+		if (max <= min) return min;
+		const auto range = static_cast<std::uint64_t>(std::int64_t{max} - min) + 1;
+		const auto threshold = ((std::uint64_t{1} << 32) - range) % range;
+		while (true) {
+			const auto product = ((*this)() >> 32) * range;
+			if ((product & 0xFFFFFFFFull) >= threshold)
+				return static_cast<std::int32_t>(min + static_cast<std::int64_t>(product >> 32));
+		}
+	}
+
+	// Returns float in [min, max)
+	constexpr auto next_float(const float min = 0.0f, const float max = 1.0f) -> float {
+		const auto unit = static_cast<float>((*this)() >> 40) * 0x1.0p-24f;
+		return min + unit * (max - min);
+	}
+};
+
+// Class for handing out random numbers, each thread draws from its own generator
+// generators are seeded from std::random_device, unless a global seed is set for reproducible runs
+export class RandomHandler {
+	static inline std::atomic<std::uint64_t> m_seed = 0;
+	// Bumped on every set_seed, telling threads to reseed their generators
+	static inline std::atomic<std::uint64_t> m_generation = 1;
+	static inline std::atomic<std::uint64_t> m_nextStream = 0;
+
+public:
+	// Sets global seed, 0 goes back to nondeterministic seeding
+	// threads reseed on their next draw, each getting its own stream in order of first use
+	static void set_seed(const std::uint64_t seed) {
+		m_seed = seed;
+		m_nextStream = 0;
+		m_generation.fetch_add(1, std::memory_order_release);
+	}
+
+	[[nodiscard]] static auto get_seed() -> std::uint64_t { return m_seed; }
+
+	// Returns generator of the calling thread
+	static auto generator() -> Xoshiro256 & {
+		thread_local Xoshiro256 gen;
+		thread_local std::uint64_t generation = 0;
+		if (const auto current = m_generation.load(std::memory_order_acquire);
+			generation != current) {
+			generation = current;
+			gen = Xoshiro256(next_thread_seed());
+		}
+		return gen;
+	}
+
+	static auto next_int(const std::int32_t min, const std::int32_t max) -> std::int32_t {
+		return generator().next_int(min, max);
+	}
+
+	static auto next_float(const float min = 0.0f, const float max = 1.0f) -> float {
+		return generator().next_float(min, max);
+	}
+
+	// Fills values with integers in [min, max], e.g. one per glyph or particle
+	static void fill_ints(const std::span<std::int32_t> values, const std::int32_t min,
+						  const std::int32_t max) {
+		auto &gen = generator();
+		for (auto &value : values) value = gen.next_int(min, max);
+	}
+
+	// Fills values with floats in [min, max)
+	static void fill_floats(const std::span<float> values, const float min = 0.0f,
+							const float max = 1.0f) {
+		auto &gen = generator();
+		for (auto &value : values) value = gen.next_float(min, max);
+	}
+
+private:
+	static auto next_thread_seed() -> std::uint64_t {
+		if (const auto seed = m_seed.load(); seed != 0) {
+			auto stream = seed + m_nextStream.fetch_add(1);
+			return splitmix64(stream);
+		}
+		std::random_device rd;
+		return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+	}
+};
@@ -14,6 +14,7 @@ import common;
 import runner;
 import filesystem;
 import pythonmodule;
+import grammar;
 
 namespace py = pybind11;
 
@@ -52,6 +53,39 @@ public:
 	[[nodiscard]] auto is_valid() const -> bool { return valid; }
 	[[nodiscard]] auto get_name() const -> std::string { return path.filename().string(); }
 	[[nodiscard]] auto get_call_string() const -> std::string { return path.stem().string(); }
+	// Returns PRIORITY attribute of the script, 0 if it has none
+	[[nodiscard]] auto get_priority() const -> std::int32_t {
+		if (!valid || !py::hasattr(scriptmodule, "PRIORITY")) return 0;
+		try {
+			return scriptmodule.attr("PRIORITY").cast<std::int32_t>();
+		} catch (const std::exception &e) {
+			std::println("Invalid PRIORITY in script '{}': {}", path.filename().string(), e.what());
+			return 0;
+		}
+	}
+	// Returns ARG_SCHEMA attribute of the script, every argument is accepted if it has none
+	// dict of argument name to (min, max) or None, e.g. {"pitch": (0.5, 1.5), "sfx": None}
+	[[nodiscard]] auto get_arg_schema() const -> ArgSchema {
+		if (!valid || !py::hasattr(scriptmodule, "ARG_SCHEMA")) return ArgSchema::make_default();
+		try {
+			std::map<ArgKey, std::optional<std::pair<double, double>>> keys;
+			for (const auto &[name, range] : scriptmodule.attr("ARG_SCHEMA").cast<py::dict>()) {
+				const auto key = find_arg_key(name.cast<std::string>());
+				if (!key) {
+					std::println("Unknown argument '{}' in ARG_SCHEMA of script '{}'",
+								 name.cast<std::string>(), path.filename().string());
+					continue;
+				}
+				keys[*key] = std::nullopt;
+				if (!range.is_none()) keys[*key] = range.cast<std::pair<double, double>>();
+			}
+			return ArgSchema::make_only(keys);
+		} catch (const std::exception &e) {
+			std::println("Invalid ARG_SCHEMA in script '{}': {}", path.filename().string(),
+						 e.what());
+			return ArgSchema::make_default();
+		}
+	}
 	[[nodiscard]] auto has_method(const std::string &method) const -> bool {
 		if (!valid) return false;
 		return py::hasattr(scriptmodule, method.c_str());
@@ -165,33 +199,8 @@ public:
 		// Run in the Python thread
 		python_runner.add_job(
 			[] {
-				// Clear the scripts
-				scripts.clear();
-
-				const auto script_path = get_scripts_path();
-				if (!std::filesystem::exists(script_path)) {
-					// Create the directory if it doesn't exist
-					if (!std::filesystem::create_directory(script_path)) {
-						// TODO: List of error codes in some common file, which are used instead
-						return Result(1, "Failed to create scripts directory");
-					}
-				}
-
-				for (const auto &entry : std::filesystem::directory_iterator(script_path)) {
-					if (entry.is_regular_file() && entry.path().extension() == ".py") {
-						std::println("Loading script: {}", entry.path().filename().string());
-						scripts[entry.path().filename().string()] =
-							std::make_unique<Script>(entry.path());
-					}
-				}
-
-				// For each script, check and call "on_load" method
-				for (const auto &script : scripts | std::views::values) {
-					if (script->has_method("on_load"))
-						execute_script_method(script.get(), "on_load");
-				}
-
-				return Result();
+				if (const auto res = load_scripts(); !res)
+					std::println("Error: {}", res.error().describe());
 			},
 			onRefreshed);
 	}
@@ -208,4 +217,33 @@ public:
 	static auto get_scripts_path() -> std::filesystem::path {
 		return Filesystem::get_root_path() / "Scripts";
 	}
+
+private:
+	// Replaces scripts with ones found from scripts directory, must run in the Python thread
+	static auto load_scripts() -> Result {
+		// Clear the scripts
+		scripts.clear();
+
+		const auto script_path = get_scripts_path();
+		if (!std::filesystem::exists(script_path)) {
+			// Create the directory if it doesn't exist
+			if (std::error_code ec; !std::filesystem::create_directory(script_path, ec))
+				return fail(ErrorCode::eFileOpen, "Failed to create scripts directory", ec.value(),
+							format_system_error);
+		}
+
+		for (const auto &entry : std::filesystem::directory_iterator(script_path)) {
+			if (entry.is_regular_file() && entry.path().extension() == ".py") {
+				std::println("Loading script: {}", entry.path().filename().string());
+				scripts[entry.path().filename().string()] = std::make_unique<Script>(entry.path());
+			}
+		}
+
+		// For each script, check and call "on_load" method
+		for (const auto &script : scripts | std::views::values) {
+			if (script->has_method("on_load")) execute_script_method(script.get(), "on_load");
+		}
+
+		return Result();
+	}
 };
@@ -51,7 +51,7 @@ PYBIND11_EMBEDDED_MODULE(chatnotifier, m) {
 					  std::map<std::string, std::vector<std::string>>>())
 		.def_readonly("user", &TwitchChatMessage::user)
 		.def_readonly("time", &TwitchChatMessage::time)
-		.def_readonly("args", &TwitchChatMessage::args)
+		.def_property_readonly("args", &TwitchChatMessage::get_args)
 		.def("get_message", &TwitchChatMessage::get_message)
 		.def("get_command", &TwitchChatMessage::get_command);
 
@@ -10,11 +10,18 @@
 #include <algorithm>
 #include <filesystem>
 #include <map>
+#include <deque>
+#include <list>
+#include <unordered_map>
 #include <array>
 #include <tuple>
 #include <vector>
 #include <ranges>
 #include <string>
+#include <string_view>
+#include <cstring>
+#include <charconv>
+#include <span>
 #include <random>
 #include <utility>
 #include <numeric>
@@ -22,11 +29,16 @@
 #include <type_traits>
 #include <fstream>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <expected>
 #include <source_location>
 #include <functional>
 #include <condition_variable>
 #include <semaphore>
+#include <atomic>
+#include <bit>
+#include <limits>
 #include <mutex>
 #include <cmath>
 #include <numbers>
@@ -0,0 +1,155 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module trigger;
+
+import standard;
+
+// Keyword found in text
+export struct TriggerMatch {
+	std::uint32_t pattern = 0; //< Index of the keyword, in the order given to the matcher
+	std::uint32_t offset = 0;  //< Byte offset in the text
+	std::uint32_t length = 0;  //< Length in bytes
+};
+
+// How keywords are matched against text
+export struct TriggerMatchOptions {
+	bool ignoreCase = false; //< ASCII letters match regardless of case
+	bool wholeWords = true; //< Keyword can't start or end in the middle of a word
+};
+
+// Lowercases ASCII letters, independent of the process locale
+constexpr auto fold_case(const char ch) -> std::uint8_t {
+	const auto byte = static_cast<std::uint8_t>(ch);
+	return byte >= 'A' && byte <= 'Z' ? byte | 0x20 : byte;
+}
+
+// Returns whether byte is part of a word, bytes of multibyte characters count as letters
+constexpr auto is_word_byte(const char ch) -> bool {
+	const auto byte = fold_case(ch);
+	return byte >= 0x80 || byte == '_' || (byte >= '0' && byte <= '9') ||
+		   (byte >= 'a' && byte <= 'z');
+}
+
+// Aho-Corasick automaton over a set of keywords, finds every one of them in a single pass
+// immutable once built, so one instance can be shared by any number of threads
+export class TriggerMatcher {
+	std::vector<std::string> m_patterns;
+	// Case-folded byte to column of the transition table, bytes in no keyword share column 0
+	std::array<std::uint16_t, 256> m_columns{};
+	std::size_t m_columnCount = 1;
+	// Next state for every state and column, failure links already folded in
+	std::vector<std::uint32_t> m_transitions;
+	// Keywords ending in each state, including the ones reached through failure links
+	std::vector<std::uint32_t> m_outputOffsets, m_outputs;
+
+public:
+	TriggerMatcher() : TriggerMatcher(std::vector<std::string>{}) {}
+
+	// Builds automaton, empty keywords never match
+	explicit TriggerMatcher(std::vector<std::string> patterns) : m_patterns(std::move(patterns)) {
+		for (const auto &pattern : m_patterns)
+			for (const auto ch : pattern)
+				if (auto &column = m_columns[fold_case(ch)]; column == 0)
+					column = static_cast<std::uint16_t>(m_columnCount++);
+
+		// Trie of the keywords first, 0 is both the root and a missing edge
+		m_transitions.assign(m_columnCount, 0);
+		std::vector<std::vector<std::uint32_t>> ends(1);
+		for (std::uint32_t i = 0; i < m_patterns.size(); ++i) {
+			if (m_patterns[i].empty()) continue;
+			std::uint32_t state = 0;
+			for (const auto ch : m_patterns[i]) {
+				const auto edge = state * m_columnCount + m_columns[fold_case(ch)];
+				if (m_transitions[edge] == 0) {
+					m_transitions[edge] = static_cast<std::uint32_t>(ends.size());
+					ends.emplace_back();
+					m_transitions.resize(m_transitions.size() + m_columnCount, 0);
+				}
+				state = m_transitions[edge];
+			}
+			ends[state].push_back(i);
+		}
+
+		// Breadth-first, so failure state of each state is complete before the state itself
+		std::vector<std::uint32_t> failures(ends.size(), 0), order;
+		order.reserve(ends.size());
+		order.push_back(0);
+		for (std::size_t i = 0; i < order.size(); ++i) {
+			const auto state = order[i];
+			for (std::size_t column = 0; column < m_columnCount; ++column) {
+				auto &next = m_transitions[state * m_columnCount + column];
+				const auto fallback =
+					state == 0 ? 0 : m_transitions[failures[state] * m_columnCount + column];
+				if (next == 0) {
+					next = fallback;
+				} else {
+					failures[next] = fallback;
+					order.push_back(next);
+				}
+			}
+		}
+
+		// Outputs of a state are its own keywords followed by those of its failure state
+		for (const auto state : order | std::views::drop(1)) {
+			const auto &inherited = ends[failures[state]];
+			ends[state].insert(ends[state].end(), inherited.begin(), inherited.end());
+		}
+		m_outputOffsets.reserve(ends.size() + 1);
+		for (const auto &outputs : ends) {
+			m_outputOffsets.push_back(static_cast<std::uint32_t>(m_outputs.size()));
+			m_outputs.insert(m_outputs.end(), outputs.begin(), outputs.end());
+		}
+		m_outputOffsets.push_back(static_cast<std::uint32_t>(m_outputs.size()));
+	}
+
+	[[nodiscard]] auto get_patterns() const -> const std::vector<std::string> & {
+		return m_patterns;
+	}
+
+	// Calls fn with every keyword found in text, in order of where they end
+	template <typename F>
+	void for_each_match(const std::string_view text, const TriggerMatchOptions options,
+						F &&fn) const {
+		std::uint32_t state = 0;
+		for (std::size_t end = 1; end <= text.size(); ++end) {
+			state = m_transitions[state * m_columnCount + m_columns[fold_case(text[end - 1])]];
+			for (auto i = m_outputOffsets[state]; i < m_outputOffsets[state + 1]; ++i) {
+				const auto &pattern = m_patterns[m_outputs[i]];
+				const auto offset = end - pattern.size();
+				if (!options.ignoreCase && text.substr(offset, pattern.size()) != pattern)
+					continue;
+				if (options.wholeWords && !is_whole_word(text, offset, pattern)) continue;
+				fn(TriggerMatch{m_outputs[i], static_cast<std::uint32_t>(offset),
+								static_cast<std::uint32_t>(pattern.size())});
+			}
+		}
+	}
+
+	// Returns every keyword found in text, in order of where they start
+	[[nodiscard]] auto find_all(const std::string_view text,
+								const TriggerMatchOptions options = {}) const
+		-> std::vector<TriggerMatch> {
+		std::vector<TriggerMatch> matches;
+		for_each_match(text, options, [&matches](const TriggerMatch match) {
+			matches.push_back(match);
+		});
+		std::ranges::stable_sort(matches, {}, &TriggerMatch::offset);
+		return matches;
+	}
+
+private:
+	// Returns whether keyword at offset isn't joined to a word before or after it
+	// edges of the keyword that aren't word characters need no separation, e.g. ":)"
+	static auto is_whole_word(const std::string_view text, const std::size_t offset,
+							  const std::string_view pattern) -> bool {
+		const auto end = offset + pattern.size();
+		if (offset > 0 && is_word_byte(pattern.front()) && is_word_byte(text[offset - 1]))
+			return false;
+		if (end < text.size() && is_word_byte(pattern.back()) && is_word_byte(text[end]))
+			return false;
+		return true;
+	}
+};
@@ -11,7 +11,13 @@ module;
 export module twitch;
 
 import standard;
+import irc;
+import queue;
 import types;
+import users;
+import cooldown;
+import capture;
+import latency;
 import config;
 import common;
 import commands;
@@ -25,10 +31,26 @@ constexpr auto twitch_redirect_uri = "http://localhost:42069/authchatnotifier";
 // Pre-URL encoded chat:read scope
 constexpr auto twitch_scope = "chat%3Aread";
 
-// Enable usage of bitmask operators for CommandCooldownType
-// consteval void enable_bitmask_operators(CommandCooldownType) {}
+UserTable global_users;
 
-std::map<std::string, std::shared_ptr<TwitchUser>> global_users;
+// Maximum number of IRC lines handled in one batch
+constexpr std::size_t max_batch_lines = 32;
+
+// Users resolved within a batch, so repeated chatters are looked up only once per batch
+// looked up users become most recently seen, so inserts within the batch can't evict them
+struct BatchUsers {
+	std::array<std::pair<std::uint64_t, TwitchUser *>, max_batch_lines> users;
+	std::size_t count = 0;
+
+	// Returns cached user entry for name hash, looking it up from global_users on first use
+	auto resolve(const std::uint64_t hash) -> TwitchUser *& {
+		for (auto &[cachedHash, user] : std::span(users).first(count))
+			if (cachedHash == hash) return user;
+
+		users[count] = {hash, global_users.find(hash)};
+		return users[count++].second;
+	}
+};
 
 // Enum class of connection status
 export enum class ConnectionStatus { eDisconnected, eConnecting, eConnected, eError };
@@ -45,32 +67,57 @@ export class TwitchChatConnector {
 
 	static inline std::string m_oauthCode, m_oauthToken;
 
-	// Global cooldown time
-	static inline std::chrono::time_point<std::chrono::steady_clock> m_lastCommandTime;
+	// Admitted messages waiting for the dispatcher thread, so slow commands don't stall socket IO
+	static inline std::unique_ptr<BoundedQueue<TwitchChatMessage>> m_queue;
+	static inline std::thread m_dispatcher;
+	static inline std::atomic<bool> m_dispatcherStop = false, m_dispatcherWake = false;
+
+	// Capture of raw frames, for replaying traffic later
+	static inline CaptureWriter m_capture;
+	static inline std::mutex m_captureMutex;
+	static inline std::atomic<bool> m_capturing = false;
 
 public:
 	// Initializes the connector resources, with given callback
 	static auto initialize(const TwitchChatMessageCallback &onMessage) -> Result {
+		// Socket IO would keep using the queue and user table being replaced
+		if (m_connStatus > ConnectionStatus::eDisconnected)
+			return fail(ErrorCode::eAlreadyConnected, "Already connected");
+		stop_dispatcher();
+
 		m_connStatus = ConnectionStatus::eDisconnected;
 		m_onMessage = onMessage;
+		global_users.reset(global_config.userTableCapacity.value);
+		CooldownHandler::initialize();
+
+		// Start dispatcher thread, which runs the callback for queued messages
+		m_queue = std::make_unique<BoundedQueue<TwitchChatMessage>>(
+			global_config.chatQueueCapacity.value);
+		m_dispatcherStop = false;
+		m_dispatcher = std::thread(dispatcher_loop);
 		return Result();
 	}
 
 	// Cleans up resources used by the connector, disconnecting first if connected
 	static void cleanup() {
 		if (m_connStatus > ConnectionStatus::eDisconnected) disconnect();
+		stop_capture();
+		stop_dispatcher();
 	}
 
 	// Connects to the given channel's chat
 	static auto connect() -> Result {
 		// If already connected or any parameter is empty, return
-		if (m_connStatus > ConnectionStatus::eDisconnected) return Result(1, "Already connected");
+		if (m_connStatus > ConnectionStatus::eDisconnected)
+			return fail(ErrorCode::eAlreadyConnected, "Already connected");
 
 		// Set to connecting
 		m_connStatus = ConnectionStatus::eConnecting;
 
-		// Check if we have a global_config.refreshToken to use
-		if (!global_config.refreshToken.empty()) {
+		// Anonymous login needs no token, otherwise check if we have a refreshToken to use
+		if (global_config.chatAnonymous) {
+			m_oauthToken.clear();
+		} else if (!global_config.refreshToken.empty()) {
 			if (!oauth_refresh()) {
 				// Attempt full
 				if (const auto res = oauth_full(); !res) {
@@ -96,12 +143,12 @@ public:
 		m_client->setReconnect(&reconn);
 
 		// Connection making
-		if (m_client->open("ws://irc-ws.chat.twitch.tv:80") != 0) {
+		if (m_client->open(global_config.chatEndpoint.c_str()) != 0) {
 			m_connStatus = ConnectionStatus::eError;
-			return Result(2, "Failed to open connection");
+			return fail(ErrorCode::eConnection, "Failed to open connection");
 		}
 
-		std::println("Connected to Twitch");
+		std::println("Connected to {}", global_config.chatEndpoint);
 
 		return Result();
 	}
@@ -111,131 +158,200 @@ public:
 		// If not connected, return
 		if (m_connStatus == ConnectionStatus::eDisconnected) return;
 
-		m_client->stop();
+		if (m_client) m_client->stop();
 		m_connStatus = ConnectionStatus::eDisconnected;
 	}
 
 	static auto get_connection_status() { return m_connStatus; }
 
+	// Starts appending every received frame into given capture file
+	static auto start_capture(const std::filesystem::path &path) -> Result {
+		std::scoped_lock lock(m_captureMutex);
+		if (const auto res = m_capture.open(path); !res) return res;
+		m_capturing = true;
+		return Result();
+	}
+
+	static void stop_capture() {
+		std::scoped_lock lock(m_captureMutex);
+		m_capturing = false;
+		m_capture.close();
+	}
+
+	// Feeds raw frame through the pipeline as if it was received from the socket
+	static auto feed_frame(const std::string &frame) -> Result { return handle_message(frame); }
+
+	// Returns counters of the chat dispatch queue
+	static auto get_queue_stats() -> QueueStats {
+		return m_queue ? m_queue->get_stats() : QueueStats{};
+	}
+
+	// Returns counters of the user table
+	static auto get_user_table_stats() -> UserTableStats { return global_users.get_stats(); }
+
 private: // Handlers
 	static void handle_open() {
-		m_client->send(std::format("PASS oauth:{}\r\n", m_oauthToken));
-		// as channel is the same as the username of owner usually, we can use it
-		m_client->send(std::format("NICK {}\r\n", global_config.twitchChannel));
+		if (global_config.chatAnonymous) {
+			// Twitch accepts any password for the read-only justinfan users
+			m_client->send("PASS SCHMOOPIIE\r\n");
+			m_client->send(std::format("NICK justinfan{}\r\n", random_int(1000, 99999)));
+		} else {
+			m_client->send(std::format("PASS oauth:{}\r\n", m_oauthToken));
+			// as channel is the same as the username of owner usually, we can use it
+			m_client->send(std::format("NICK {}\r\n", global_config.twitchChannel));
+		}
 		m_connStatus = ConnectionStatus::eConnected;
 		std::println("Connected to Twitch chat");
 	}
 
-	static auto handle_message(const std::string &msg) -> Result {
-		// If ":tmi.twitch.tv NOTICE * :Login authentication failed" is found, report error
-		if (msg.find(":tmi.twitch.tv NOTICE * :Login authentication failed") != std::string::npos) {
-			disconnect();
-			return Result(3, "Login authentication failed");
+	static auto handle_message(const std::string &frame) -> Result {
+		const auto received = std::chrono::steady_clock::now();
+		if (m_capturing) {
+			std::scoped_lock lock(m_captureMutex);
+			if (m_capture.is_open()) m_capture.write(frame, received);
 		}
 
-		// If "PING :tmi.twitch.tv", respond with "PONG :tmi.twitch.tv"
-		if (msg.find("PING :tmi.twitch.tv") != std::string::npos) {
-			m_client->send("PONG :tmi.twitch.tv\r\n");
-			return Result();
-		}
-
-		// If ":tmi.twitch.tv 001" is received, join the channel
-		if (msg.find(":tmi.twitch.tv 001") != std::string::npos) {
-			m_client->send(std::format("JOIN #{}\r\n", global_config.twitchChannel));
-			return Result();
-		}
-
-		// Validate message, then get user and message, passing them to the callback
-		if (const std::string message = msg; message.find("PRIVMSG") != std::string::npos) {
-			auto user = message.substr(1, message.find('!') - 1);
-			// Trim away newlines, carriage returns and tabs
-			std::erase(user, '\n');
-			std::erase(user, '\r');
-			std::erase(user, '\t');
-
-			auto chat = message.substr(message.find(':', 1) + 1);
-			// Trim away newlines, carriage returns and tabs
-			std::erase(chat, '\n');
-			std::erase(chat, '\r');
-			std::erase(chat, '\t');
-
-			const auto chatMsg = TwitchChatMessage(user, chat);
-			if (!chatMsg.is_command()) {
-				if (!global_users.contains(user)) {
-					const auto twUser = std::make_shared<TwitchUser>(user, chatMsg);
-					// twUser->userVoice = random_int(0, TTSHandler::get_num_voices() - 1);
-					global_users[user] = twUser;
-				} else
-					global_users[user]->lastMessage = chatMsg;
-
-				return Result();
+		// Twitch packs multiple "\r\n" terminated lines into one frame, handle them in batches
+		auto remaining = std::string_view(frame);
+		while (!remaining.empty()) {
+			std::array<IRCMessage, max_batch_lines> batch;
+			std::size_t batchSize = 0;
+			while (batchSize < batch.size() && !remaining.empty()) {
+				if (const auto ircMsg = parse_irc_line(next_irc_line(remaining)))
+					batch[batchSize++] = *ircMsg;
 			}
 
-			// Check cooldowns (global_config.enabledCooldowns, global_config.cooldownTime)
-			// before calling the callback
-			if (global_config.enabledCooldowns & CommandCooldownType::eGlobal) {
-				const auto now = std::chrono::steady_clock::now();
-				if (now - m_lastCommandTime <
-					std::chrono::seconds(global_config.cooldownGlobal.value))
-					return Result();
+			if (const auto res = handle_batch(std::span(batch).first(batchSize), received); !res)
+				return res;
+		}
+		return Result();
+	}
 
-				m_lastCommandTime = now;
-			}
-			if (global_config.enabledCooldowns & CommandCooldownType::ePerUser) {
-				if (global_users.contains(user)) {
-					if (const auto now = std::chrono::steady_clock::now();
-						now - global_users[user]->lastMessage.time <
-							std::chrono::seconds(global_config.cooldownPerUser.value) &&
-						!global_users[user]->bypassCooldown)
-						return Result();
+	// Runs parsed lines of a frame through cooldowns, queueing admitted ones for dispatch
+	static auto handle_batch(const std::span<const IRCMessage> batch,
+							 const std::chrono::time_point<std::chrono::steady_clock> received)
+		-> Result {
+		// Clock is read once for the whole batch, which is also when its lines were parsed
+		const auto now = std::chrono::steady_clock::now();
+		BatchUsers users;
+
+		for (const auto &ircMsg : batch) {
+			switch (ircMsg.command) {
+			// Respond to "PING :tmi.twitch.tv" with "PONG :tmi.twitch.tv"
+			case IRCCommand::ePing:
+				send(std::format("PONG :{}\r\n", ircMsg.trailing));
+				break;
+			// Welcome message received, join the channel
+			case IRCCommand::eWelcome:
+				send(std::format("JOIN #{}\r\n", global_config.twitchChannel));
+				break;
+			// ":tmi.twitch.tv NOTICE * :Login authentication failed"
+			case IRCCommand::eNotice:
+				if (ircMsg.trailing.starts_with("Login authentication failed")) {
+					disconnect();
+					return fail(ErrorCode::eAuthentication, "Login authentication failed");
 				}
+				break;
+			case IRCCommand::ePrivmsg: {
+				const auto userHash = hash_user_name(ircMsg.get_nick());
+				handle_privmsg(ircMsg, received, now, userHash, users.resolve(userHash));
+				break;
 			}
-			if (global_config.enabledCooldowns & CommandCooldownType::ePerCommand) {
-				if (!chatMsg.is_command()) return Result();
-				// Get the command from the message
-				const auto extractedCommand = chatMsg.get_command();
-				const auto cmdLastExec = CommandHandler::get_last_executed_time(
-					CommandHandler::get_command_key(extractedCommand));
-				if (const auto now = std::chrono::steady_clock::now();
-					now - cmdLastExec <
-					std::chrono::seconds(global_config.cooldownPerCommand.value))
-					return Result();
+			default:
+				break;
 			}
+		}
+		return Result();
+	}
 
-			if (chatMsg.is_command()) {
-				if (!global_users.contains(user)) {
-					const auto twUser = std::make_shared<TwitchUser>(user, chatMsg);
-					// twUser->userVoice = random_int(0, TTSHandler::get_num_voices() - 1);
-					global_users[user] = twUser;
-				} else
-					global_users[user]->lastMessage = chatMsg;
-			}
+	// Handles PRIVMSG, only allocating once message is known to be an admitted command
+	// user is the batch-cached entry for the sender, nullptr if they haven't been seen yet
+	static void handle_privmsg(const IRCMessage &ircMsg,
+							   const std::chrono::time_point<std::chrono::steady_clock> received,
+							   const std::chrono::time_point<std::chrono::steady_clock> now,
+							   const std::uint64_t userHash, TwitchUser *&user) {
+		const auto name = ircMsg.get_nick();
+		const auto chat = ircMsg.trailing;
+
+		if (!user) {
+			user = &global_users.insert(userHash);
+			// user->userVoice = RandomHandler::next_int(0, TTSHandler::get_num_voices() - 1);
+		}
+		user->lastMessageTime = now;
+
+		const auto command = extract_command(chat);
+		if (command.empty()) return;
+
+		// Check cooldowns (global_config.enabledCooldowns) before handing over to the callback
+		const auto commandId = CommandHandler::find_command_id(command);
+		if (!CooldownHandler::admit(now, user->cooldown, userHash,
+									user->flags & TwitchUserFlags::eBypassCooldown, commandId))
+			return;
+
+		// Admitted, parse the message into its own arena (trimming away tabs) and hand it over
+		// to the dispatcher, nothing before this point allocates for a known user
+		auto chatMsg =
+			TwitchChatMessage(std::string(name), chat, CommandHandler::get_arg_schema(commandId));
+		chatMsg.trace = LatencyTracker::new_trace(received);
+		chatMsg.trace->mark(LatencyStage::eParsed, now);
+		chatMsg.trace->mark(LatencyStage::eAdmitted);
+		m_queue->push(std::move(chatMsg), global_config.chatQueueOverflow);
+		wake_dispatcher();
+	}
+
+	// Sends to the server, if there is one (replayed frames have none)
+	static void send(const std::string &msg) {
+		if (m_client) m_client->send(msg);
+	}
+
+	// Wakes dispatcher thread if it's waiting for messages
+	static void wake_dispatcher() {
+		if (!m_dispatcherWake.exchange(true)) m_dispatcherWake.notify_one();
+	}
 
-			if (m_onMessage) m_onMessage(chatMsg);
-			else std::println("Message handled withou onMessage callback");
+	// Stops dispatcher thread if it's running, dropping messages still queued
+	static void stop_dispatcher() {
+		if (m_dispatcher.joinable()) {
+			m_dispatcherStop = true;
+			wake_dispatcher();
+			m_dispatcher.join();
 		}
+		m_queue.reset();
+	}
 
-		return Result();
+	// Dispatcher thread, runs the callback for queued messages
+	static void dispatcher_loop() {
+		while (!m_dispatcherStop) {
+			m_dispatcherWake.wait(false);
+			// Clear before draining, so messages pushed during draining wake us again
+			m_dispatcherWake = false;
+			while (auto chatMsg = m_queue->try_pop()) {
+				if (m_onMessage) m_onMessage(*chatMsg);
+				else std::println("Message handled withou onMessage callback");
+			}
+		}
 	}
 
 	static void handle_close() { m_connStatus = ConnectionStatus::eDisconnected; }
 
 	static auto oauth_refresh() -> Result {
-		// Just post to https://id.twitch.tv/oauth2/token with refresh_token
+		// Just post to oauthEndpoint/token with refresh_token
 		const auto tokenUrl =
-			std::format("https://id.twitch.tv/oauth2/token?client_id={}&client_secret={}&"
+			std::format("{}/token?client_id={}&client_secret={}&"
 						"refresh_token={}&grant_type=refresh_token",
-						twitch_client_id, TWITCH_CLIENT_SECRET, global_config.refreshToken);
+						global_config.oauthEndpoint, twitch_client_id, TWITCH_CLIENT_SECRET,
+						global_config.refreshToken);
 
 		if (const auto resp = requests::post(tokenUrl.c_str()); !resp)
-			return Result(2, "Failed to get OAuth token");
+			return fail(ErrorCode::eConnection, "Failed to get OAuth token");
 		else {
 			// Get the token and refresh token from the response
 			const auto json = resp->GetJson();
 			if (json.contains("access_token"))
 				m_oauthToken = json["access_token"].get<std::string>();
 			else
-				return Result(3, "Failed to get OAuth token from json");
+				return fail(ErrorCode::eAuthentication, "Failed to get OAuth token from json",
+							resp->status_code, format_http_status);
 
 			if (json.contains("refresh_token"))
 				global_config.refreshToken = json["refresh_token"].get<std::string>();
@@ -265,9 +381,9 @@ private: // Handlers
 
 		// Open browser to get OAuth token
 		const auto url =
-			std::format("https://id.twitch.tv/oauth2/"
-						"authorize?response_type=code&client_id={}&redirect_uri={}&scope={}",
-						twitch_client_id, twitch_redirect_uri, twitch_scope);
+			std::format("{}/authorize?response_type=code&client_id={}&redirect_uri={}&scope={}",
+						global_config.oauthEndpoint, twitch_client_id, twitch_redirect_uri,
+						twitch_scope);
 
 		// Open browser, based on OS ifdef's
 #if defined(_WIN32)
@@ -283,23 +399,26 @@ private: // Handlers
 		server.stop();
 
 		// Check if we have a code
-		if (m_oauthCode.empty()) return Result(2, "Failed to get OAuth code");
+		if (m_oauthCode.empty())
+			return fail(ErrorCode::eAuthentication, "Failed to get OAuth code");
 
 		// Get OAuth token from https://id.twitch.tv/oauth2/token
 		const auto tokenUrl =
-			std::format("https://id.twitch.tv/oauth2/token?client_id={}&client_secret={}&code={}&"
+			std::format("{}/token?client_id={}&client_secret={}&code={}&"
 						"grant_type=authorization_code&redirect_uri={}",
-						twitch_client_id, TWITCH_CLIENT_SECRET, m_oauthCode, twitch_redirect_uri);
+						global_config.oauthEndpoint, twitch_client_id, TWITCH_CLIENT_SECRET,
+						m_oauthCode, twitch_redirect_uri);
 
 		if (const auto resp = requests::post(tokenUrl.c_str()); !resp)
-			return Result(4, "Failed to get OAuth token");
+			return fail(ErrorCode::eConnection, "Failed to get OAuth token");
 		else {
 			// Get the token and refresh token from the response
 			const auto json = resp->GetJson();
 			if (json.contains("access_token"))
 				m_oauthToken = json["access_token"].get<std::string>();
 			else
-				return Result(5, "Failed to get OAuth token from json");
+				return fail(ErrorCode::eAuthentication, "Failed to get OAuth token from json",
+							resp->status_code, format_http_status);
 
 			if (json.contains("refresh_token"))
 				global_config.refreshToken = json["refresh_token"].get<std::string>();
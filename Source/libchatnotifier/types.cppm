@@ -7,148 +7,161 @@ export module types;
 
 import standard;
 import common;
+import latency;
+import coalesce;
+export import grammar;
+
+// Converts number decoded at parse time to wanted type
+// @return nullopt if decoding failed, or the number doesn't fit the type
+template <typename T>
+requires std::is_arithmetic_v<T> && (!std::same_as<T, bool>)
+auto number_to(const std::expected<double, DecodeError> &number) -> std::optional<T> {
+	if (!number) return std::nullopt;
+	if constexpr (std::is_integral_v<T>) {
+		// max + 1 is exact as double even for 64-bit types, unlike max itself
+		if (*number != std::trunc(*number) ||
+			*number < static_cast<double>(std::numeric_limits<T>::lowest()) ||
+			*number >= static_cast<double>(std::numeric_limits<T>::max()) + 1.0)
+			return std::nullopt;
+		return static_cast<T>(*number);
+	} else {
+		if (std::abs(*number) > static_cast<double>(std::numeric_limits<T>::max()))
+			return std::nullopt;
+		return static_cast<T>(*number);
+	}
+}
 
 // Struct for Twitch message data
+// message is parsed once on construction, copies and submessages share the parse
 export struct TwitchChatMessage {
-	std::string user, message, command;
+	std::string user;
 	std::chrono::time_point<std::chrono::steady_clock> time;
-	std::map<std::string, std::vector<std::string>> args;
+	std::shared_ptr<const ParsedMessage> parsed;
+	std::int32_t group = -1; //< Argument group this submessage is of, -1 for the whole message
+	std::shared_ptr<MessageTrace> trace; //< Latency trace, only set for admitted chat messages
+	RepeatCounter repeats; //< Identical messages folded into this one, set by coalescing
+	std::int32_t priority = 0; //< Priority of the command, lower is shed first under load
 
-	TwitchChatMessage(std::string user, std::string message)
-		: user(std::move(user)), message(std::move(message)),
-		  time(std::chrono::steady_clock::now()) {
-		args = get_command_args()[0];
-		command = get_command();
+	// schema is of the command message calls, its arguments are validated against it here
+	TwitchChatMessage(std::string user, const std::string_view message,
+					  const ArgSchema &schema = ArgSchema::make_default())
+		: user(std::move(user)), time(std::chrono::steady_clock::now()) {
+		auto parsedMessage = std::make_shared<ParsedMessage>();
+		parse_chat_message(*parsedMessage, message, schema);
+		parsed = std::move(parsedMessage);
 	}
 
-	TwitchChatMessage(std::string user, std::string message, std::string command,
+	// Makes submessage out of already separated parts, as given by scripts
+	TwitchChatMessage(std::string user, const std::string &message, const std::string &command,
 					  std::chrono::time_point<std::chrono::steady_clock> time,
-					  std::map<std::string, std::vector<std::string>> groupArgs)
-		: user(std::move(user)), message(std::move(message)), command(std::move(command)),
-		  time(time), args(std::move(groupArgs)) {}
+					  const std::map<std::string, std::vector<std::string>> &groupArgs)
+		: user(std::move(user)), time(time), group(0) {
+		auto parsedMessage = std::make_shared<ParsedMessage>();
+		make_parsed_message(*parsedMessage, message, command, groupArgs);
+		parsed = std::move(parsedMessage);
+	}
+
+	// Returns the message as it was received
+	[[nodiscard]] auto get_raw() const -> std::string_view { return parsed->view(parsed->message); }
 
 	// Commands can be given arguments like so
 	// "!cmd <arg1=value1,arg2=value2> message <arg3=value3|value4|value5> another message" etc.
-	// @return map of arg/values groups (each <> pair is a group)
-	// to another map of arg to it's values
-	[[nodiscard]] auto get_command_args() const
-		-> std::map<std::uint32_t, std::map<std::string, std::vector<std::string>>> {
-		// Get each argument group
-		auto result = std::map<std::uint32_t, std::map<std::string, std::vector<std::string>>>{};
-		const auto argGroups = get_strings_between(message, "<", ">");
-		for (std::uint32_t i = 0; i < argGroups.size(); ++i) {
-			for (const auto argList = split_string(argGroups[i], ","); const auto &arg : argList) {
-				const auto splitted = split_string(arg, "=");
-				if (splitted.size() != 2) continue;
-				if (const auto vals = split_string(splitted[1], "|"); !vals.empty())
-					result[i][splitted[0]] = vals;
-				else
-					result[i][splitted[0]].emplace_back(splitted[1]);
-			}
+	// @return map of arg to it's values, of this submessage's group (or the first one)
+	[[nodiscard]] auto get_args() const -> std::map<std::string, std::vector<std::string>> {
+		std::map<std::string, std::vector<std::string>> result;
+		const auto groupIndex = static_cast<std::size_t>(std::max(group, 0));
+		if (groupIndex >= parsed->groups.size()) return result;
+
+		const auto &groupData = parsed->groups[groupIndex];
+		for (const auto &arg :
+			 std::span(parsed->args).subspan(groupData.firstArg, groupData.argCount)) {
+			auto &values = result[std::string(parsed->view(arg.key))];
+			values.clear();
+			for (const auto value : parsed->get_values(arg))
+				values.emplace_back(parsed->view(value));
 		}
 		return result;
 	}
 
 	// A nicer way of getting command arguments
-	// @return optional value of the argument within specified group
+	// numbers come from slots decoded (and clamped) at parse time, invalid ones give nullopt
+	// @return optional value of the argument within this submessage's group (or the first one)
 	template <typename T>
-	auto get_command_arg(const std::string &argName) const -> std::optional<T> {
+	auto get_command_arg(const ArgKey key) const -> std::optional<T> {
 		if (!is_command()) return std::nullopt;
-		if (!args.contains(argName)) return std::nullopt;
-		if constexpr (std::same_as<T, std::string>)
-			return args.at(argName)[0];
-		else if constexpr (std::is_integral_v<T> || std::is_floating_point_v<T>)
-			return t_from_string<T>(args.at(argName)[0]);
-		// Vector handling and Position 2D/3D handling
-		else if constexpr (std::same_as<T, std::vector<std::string>>)
-			return args.at(argName);
-		else if constexpr (std::same_as<T, Position2D>) {
-			if (args.at(argName).size() < 2) return std::nullopt;
-			return Position2D{t_from_string<float>(args.at(argName)[0]),
-							  t_from_string<float>(args.at(argName)[1])};
-		} else if constexpr (std::same_as<T, Position3D>) {
-			if (args.at(argName).size() < 2) return std::nullopt;
-			// Allow for 2D positions to be used as 3D
-			if (args.at(argName).size() == 2)
-				return Position3D{t_from_string<float>(args.at(argName)[0]),
-								  t_from_string<float>(args.at(argName)[1]), 0.0f};
+		return decode_arg<T>(parsed->find_arg(static_cast<std::size_t>(std::max(group, 0)), key));
+	}
 
-			return Position3D{t_from_string<float>(args.at(argName)[0]),
-							  t_from_string<float>(args.at(argName)[1]),
-							  t_from_string<float>(args.at(argName)[2])};
-		}
-		return std::nullopt;
+	// Same, for arguments by name, known names map to their key
+	template <typename T>
+	auto get_command_arg(const std::string_view argName) const -> std::optional<T> {
+		if (!is_command()) return std::nullopt;
+		return decode_arg<T>(
+			parsed->find_arg(static_cast<std::size_t>(std::max(group, 0)), argName));
 	}
 
-	// Splits this message into multiple submessages
+	// Splits this message into submessages, one per argument group
+	// submessages share the parse of this message, only pointing to their group
 	[[nodiscard]] auto split_into_submessages() const -> std::vector<TwitchChatMessage> {
-		if (!is_command()) return {*this};
-		if (const auto argGroups = get_strings_between(message, "<", ">"); argGroups.empty())
-			return {*this};
-		else {
-			auto command = get_command();
-			auto groups = std::vector<TwitchChatMessage>{};
-			for (const auto &argGroup : argGroups) {
-				auto groupArgs = std::map<std::string, std::vector<std::string>>{};
-				auto groupMsg = get_string_after(message, argGroup + ">");
-				groupMsg = get_string_until(groupMsg, "<");
-				for (const auto &arg : split_string(argGroup, ",")) {
-					const auto argSplit = split_string(arg, "=");
-					if (argSplit.size() != 2) continue;
-					groupArgs[argSplit[0]] = split_string(argSplit[1], "|");
-				}
-				groups.emplace_back(user, groupMsg, command, time, groupArgs);
-			}
-			return groups;
-		}
-	}
+		if (!is_command() || group >= 0 || parsed->groups.empty()) return {*this};
 
-	[[nodiscard]] auto is_command() const -> bool {
-		return message.starts_with("!") || !command.empty();
+		auto groups = std::vector<TwitchChatMessage>(parsed->groups.size(), *this);
+		for (std::size_t i = 0; i < groups.size(); ++i)
+			groups[i].group = static_cast<std::int32_t>(i);
+		return groups;
 	}
 
+	[[nodiscard]] auto is_command() const -> bool { return parsed->isCommand; }
+
 	[[nodiscard]] auto get_command() const -> std::string {
-		if (!is_command()) return "";
-		if (command.empty()) {
-			if (message.starts_with("!")) {
-				auto command = get_string_after(message, "!");
-				command = get_string_until(command, " ");
-				command = get_string_until(command, "<");
-				return trim_string(command);
-			} else
-				return "";
-		} else
-			return command;
+		return std::string(parsed->view(parsed->command));
 	}
 
 	[[nodiscard]] auto get_message() const -> std::string {
-		if (!is_command()) return message;
-		if (const auto argGroups = get_strings_between(message, "<", ">"); argGroups.empty()) {
-			if (message.starts_with("!") && !command.empty())
-				return get_string_after(message, command);
-			else
-				return message;
-		} else {
-			// Erase all argument groups from the message, joining remaining parts by space
-			std::vector<std::string> messages;
-			for (const auto &argGroup : argGroups) {
-				const auto groupMsg = get_string_after(message, argGroup + ">");
-				messages.emplace_back(get_string_until(groupMsg, "<"));
-			}
-			return std::accumulate(
-				messages.begin(), messages.end(), std::string{},
-				[](const std::string &a, const std::string &b) { return a + " " + b; });
+		if (group >= 0) return std::string(parsed->view(parsed->groups[group].text));
+		if (!is_command() || parsed->groups.empty())
+			return std::string(parsed->view(parsed->text));
+
+		// Join texts of every argument group, each prefixed by space
+		std::string result;
+		for (const auto &groupData : parsed->groups) {
+			result += ' ';
+			result += parsed->view(groupData.text);
 		}
+		return result;
 	}
-};
 
-// Struct for holding user data
-export struct TwitchUser {
-	std::string name;
-	bool bypassCooldown = false;
-	TwitchChatMessage lastMessage;
-	std::int32_t userVoice = -1;
+private:
+	template <typename T>
+	auto decode_arg(const ParsedArg *arg) const -> std::optional<T> {
+		if (!arg || arg->valueCount == 0) return std::nullopt;
 
-	explicit TwitchUser(std::string name, TwitchChatMessage lastMessage)
-		: name(std::move(name)), lastMessage(std::move(lastMessage)) {}
-};
\ No newline at end of file
+		const auto values = parsed->get_values(*arg);
+		const auto numbers = parsed->get_numbers(*arg);
+		if constexpr (std::same_as<T, std::string>)
+			return std::string(parsed->view(values[0]));
+		else if constexpr (std::same_as<T, bool>)
+			return parsed->view(values[0]) == "true";
+		else if constexpr (std::is_arithmetic_v<T>)
+			return number_to<T>(numbers[0]);
+		// Vector handling and Position 2D/3D handling
+		else if constexpr (std::same_as<T, std::vector<std::string>>) {
+			std::vector<std::string> result;
+			for (const auto value : values) result.emplace_back(parsed->view(value));
+			return result;
+		} else if constexpr (std::same_as<T, Position2D>) {
+			if (numbers.size() < 2) return std::nullopt;
+			const auto x = number_to<float>(numbers[0]), y = number_to<float>(numbers[1]);
+			if (!x || !y) return std::nullopt;
+			return Position2D{*x, *y};
+		} else if constexpr (std::same_as<T, Position3D>) {
+			if (numbers.size() < 2) return std::nullopt;
+			// Allow for 2D positions to be used as 3D
+			const auto x = number_to<float>(numbers[0]), y = number_to<float>(numbers[1]);
+			const auto z = numbers.size() == 2 ? std::optional(0.0f) : number_to<float>(numbers[2]);
+			if (!x || !y || !z) return std::nullopt;
+			return Position3D{*x, *y, *z};
+		}
+		return std::nullopt;
+	}
+};
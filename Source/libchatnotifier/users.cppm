@@ -0,0 +1,164 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+module;
+#include <standard.hpp>
+#endif
+
+export module users;
+
+import standard;
+import cooldown;
+
+// Flags of a Twitch user
+export enum class TwitchUserFlags : std::uint8_t { eNone = 0, eBypassCooldown = 1 << 0 };
+
+// Enable usage of bitmask operators for TwitchUserFlags
+export consteval void enable_bitmask_operators(TwitchUserFlags) {}
+
+// Returns hash of user name, which is used as the user's identity
+// FNV-1a, with 0 reserved for empty table slots
+export constexpr auto hash_user_name(const std::string_view name) -> std::uint64_t {
+	std::uint64_t hash = 14695981039346656037ull;
+	for (const auto ch : name) {
+		hash ^= static_cast<std::uint8_t>(ch);
+		hash *= 1099511628211ull;
+	}
+	return hash == 0 ? 1 : hash;
+}
+
+// Compact fixed-size record of user data
+export struct TwitchUser {
+	std::uint64_t nameHash = 0;
+	std::chrono::time_point<std::chrono::steady_clock> lastMessageTime;
+	CooldownState cooldown;
+	TwitchUserFlags flags = TwitchUserFlags::eNone;
+	std::int32_t userVoice = -1;
+
+	// Links for least-recently-used list, indices into record array
+	std::uint32_t lruPrev = 0, lruNext = 0;
+};
+
+// Snapshot of user table counters
+export struct UserTableStats {
+	std::size_t capacity = 0, size = 0;
+	std::uint64_t evictions = 0;
+};
+
+// Table of users, open-addressing hash index over a fixed-size array of records
+// once full, least recently seen user is evicted to make room
+export class UserTable {
+	static constexpr auto npos = std::numeric_limits<std::uint32_t>::max();
+
+	// Index slot, hash of 0 means slot is empty
+	struct Slot {
+		std::uint64_t hash = 0;
+		std::uint32_t record = 0;
+	};
+
+	std::vector<Slot> m_slots;
+	std::vector<TwitchUser> m_records;
+	std::size_t m_size = 0;
+	std::uint64_t m_evictions = 0;
+	// Most and least recently used records
+	std::uint32_t m_lruHead = npos, m_lruTail = npos;
+
+public:
+	explicit UserTable(const std::size_t capacity = 0) { reset(capacity); }
+
+	// Clears the table, resizing it to hold given amount of users
+	void reset(const std::size_t capacity) {
+		// Keep index at most half full, so probe sequences stay short
+		m_slots.assign(std::bit_ceil(std::max<std::size_t>(capacity * 2, 2)), Slot{});
+		m_records.assign(std::max<std::size_t>(capacity, 1), TwitchUser{});
+		m_size = 0;
+		m_evictions = 0;
+		m_lruHead = m_lruTail = npos;
+	}
+
+	// Looks up user by name hash, marking them as most recently seen
+	// @return user record, or nullptr if user is not known
+	auto find(const std::uint64_t hash) -> TwitchUser * {
+		const auto slot = find_slot(hash);
+		if (m_slots[slot].hash == 0) return nullptr;
+
+		const auto record = m_slots[slot].record;
+		touch(record);
+		return &m_records[record];
+	}
+
+	// Inserts user which is not in the table yet, evicting least recently seen user if full
+	// returned record stays valid until it becomes the least recently seen one and is evicted
+	auto insert(const std::uint64_t hash) -> TwitchUser & {
+		std::uint32_t record = 0;
+		if (m_size < m_records.size())
+			record = static_cast<std::uint32_t>(m_size++);
+		else {
+			record = m_lruTail;
+			erase_slot(find_slot(m_records[record].nameHash));
+			unlink(record);
+			++m_evictions;
+		}
+
+		m_records[record] = TwitchUser{.nameHash = hash};
+		m_slots[find_slot(hash)] = Slot{hash, record};
+		push_front(record);
+		return m_records[record];
+	}
+
+	[[nodiscard]] auto size() const -> std::size_t { return m_size; }
+	[[nodiscard]] auto capacity() const -> std::size_t { return m_records.size(); }
+
+	[[nodiscard]] auto get_stats() const -> UserTableStats {
+		return {m_records.size(), m_size, m_evictions};
+	}
+
+private:
+	// Returns slot holding hash, or the empty slot where it would be inserted
+	[[nodiscard]] auto find_slot(const std::uint64_t hash) const -> std::size_t {
+		const auto mask = m_slots.size() - 1;
+		auto slot = hash & mask;
+		while (m_slots[slot].hash != 0 && m_slots[slot].hash != hash) slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	// Removes slot, shifting following entries back so no tombstones are needed
+	void erase_slot(std::size_t slot) {
+		const auto mask = m_slots.size() - 1;
+		auto next = slot;
+		while (true) {
+			next = (next + 1) & mask;
+			if (m_slots[next].hash == 0) break;
+
+			// Move entry back only if its home position isn't cyclically between slot and next
+			const auto home = m_slots[next].hash & mask;
+			if (((next - home) & mask) >= ((next - slot) & mask)) {
+				m_slots[slot] = m_slots[next];
+				slot = next;
+			}
+		}
+		m_slots[slot] = Slot{};
+	}
+
+	// Moves record to the front of LRU list
+	void touch(const std::uint32_t record) {
+		if (m_lruHead == record) return;
+		unlink(record);
+		push_front(record);
+	}
+
+	void unlink(const std::uint32_t record) {
+		auto &user = m_records[record];
+		if (user.lruPrev != npos) m_records[user.lruPrev].lruNext = user.lruNext;
+		else m_lruHead = user.lruNext;
+		if (user.lruNext != npos) m_records[user.lruNext].lruPrev = user.lruPrev;
+		else m_lruTail = user.lruPrev;
+	}
+
+	void push_front(const std::uint32_t record) {
+		auto &user = m_records[record];
+		user.lruPrev = npos;
+		user.lruNext = m_lruHead;
+		if (m_lruHead != npos) m_records[m_lruHead].lruPrev = record;
+		m_lruHead = record;
+		if (m_lruTail == npos) m_lruTail = record;
+	}
+};
@@ -0,0 +1,118 @@
+module;
+
+#ifndef CN_SUPPORTS_MODULES_STD
+#include <standard.hpp>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CN_UTF8_SSE2
+#endif
+
+export module utf8;
+
+import standard;
+
+// Code point of UTF-8 text, with the bytes it was decoded from
+export struct Utf8Char {
+	char32_t codepoint = 0;
+	std::uint32_t offset = 0; //< Byte offset in the text
+	std::uint32_t length = 0; //< Length in bytes
+};
+
+constexpr char32_t replacement_char = U'\uFFFD';
+
+// Returns length of the run of ASCII bytes at the start of str
+// 16 bytes at a time with SSE2, 8 at a time otherwise
+auto ascii_prefix(const std::string_view str) -> std::size_t {
+	std::size_t length = 0;
+#ifdef CN_UTF8_SSE2
+	while (str.size() - length >= 16) {
+		const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str.data() + length));
+		if (const auto mask = static_cast<unsigned>(_mm_movemask_epi8(block)); mask != 0)
+			return length + std::countr_zero(mask);
+		length += 16;
+	}
+#endif
+	if constexpr (std::endian::native == std::endian::little) {
+		while (str.size() - length >= 8) {
+			std::uint64_t word;
+			std::memcpy(&word, str.data() + length, sizeof(word));
+			if (const auto high = word & 0x8080808080808080ull; high != 0)
+				return length + std::countr_zero(high) / 8;
+			length += 8;
+		}
+	}
+	while (length < str.size() && static_cast<std::uint8_t>(str[length]) < 0x80) ++length;
+	return length;
+}
+
+// Decodes code point at the start of str, which must not be empty
+// invalid, overlong, surrogate or truncated sequences give U+FFFD for their first byte only
+constexpr auto decode_utf8_char(const std::string_view str) -> std::pair<char32_t, std::uint32_t> {
+	const auto lead = static_cast<std::uint8_t>(str[0]);
+	if (lead < 0x80) return {lead, 1};
+
+	std::uint32_t length = 0;
+	char32_t codepoint = 0, minimum = 0;
+	if ((lead & 0xE0) == 0xC0)
+		length = 2, codepoint = lead & 0x1F, minimum = 0x80;
+	else if ((lead & 0xF0) == 0xE0)
+		length = 3, codepoint = lead & 0x0F, minimum = 0x800;
+	else if ((lead & 0xF8) == 0xF0)
+		length = 4, codepoint = lead & 0x07, minimum = 0x10000;
+	else
+		return {replacement_char, 1};
+	if (str.size() < length) return {replacement_char, 1};
+
+	for (std::uint32_t i = 1; i < length; ++i) {
+		const auto byte = static_cast<std::uint8_t>(str[i]);
+		if ((byte & 0xC0) != 0x80) return {replacement_char, 1};
+		codepoint = (codepoint << 6) | (byte & 0x3F);
+	}
+	if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+		return {replacement_char, 1};
+	return {codepoint, length};
+}
+
+// Calls fn with every code point of UTF-8 text in order, independent of the process locale
+export template <typename F>
+void for_each_utf8_char(const std::string_view str, F &&fn) {
+	std::size_t offset = 0;
+	while (offset < str.size()) {
+		// Chat is mostly ASCII, which needs no decoding at all
+		const auto ascii = ascii_prefix(str.substr(offset));
+		for (const auto end = offset + ascii; offset < end; ++offset)
+			fn(Utf8Char{static_cast<char32_t>(str[offset]), static_cast<std::uint32_t>(offset), 1});
+		if (offset == str.size()) break;
+
+		const auto [codepoint, length] = decode_utf8_char(str.substr(offset));
+		fn(Utf8Char{codepoint, static_cast<std::uint32_t>(offset), length});
+		offset += length;
+	}
+}
+
+// Decodes UTF-8 text into a packed array of code points
+export auto decode_utf8(const std::string_view str) -> std::vector<Utf8Char> {
+	std::vector<Utf8Char> chars;
+	chars.reserve(str.size());
+	for_each_utf8_char(str, [&chars](const Utf8Char ch) { chars.push_back(ch); });
+	return chars;
+}
+
+// Line of UTF-8 text with its code points, offsets of the characters are relative to the line
+export struct Utf8Line {
+	std::string_view text;
+	std::vector<Utf8Char> characters;
+};
+
+// Splits UTF-8 text on '\n' and decodes each line, trailing newline gives a last empty line
+// lines view into str, so it must outlive them
+export auto decode_utf8_lines(const std::string_view str) -> std::vector<Utf8Line> {
+	std::vector<Utf8Line> lines;
+	for (const auto line : str | std::views::split('\n')) {
+		const auto text = std::string_view(line.begin(), line.end());
+		lines.emplace_back(text, decode_utf8(text));
+	}
+	return lines;
+}
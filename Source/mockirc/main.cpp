@@ -0,0 +1,275 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+#include <standard.hpp>
+#endif
+
+#include <csignal>
+
+#include <hv/WebSocketServer.h>
+
+import standard;
+import irc;
+
+// Stand-in for Twitch IRC WebSocket server, for load testing the client offline
+// speaks enough of the handshake (PASS/NICK/001/JOIN/PING) and floods joined clients with
+// synthetic PRIVMSG traffic, point chatEndpoint at it with chatAnonymous enabled
+// usage: mockirc [--port N] [--rate msgs/s] [--users N] [--command-ratio 0..1]
+//                [--command "!cc text"]... [--lines-per-frame N] [--ping-every s]
+//                [--reconnect-every s] [--threads N]
+
+struct MockOptions {
+	int port = 8080, threads = 2;
+	double rate = 1000.0, commandRatio = 0.1, pingEvery = 60.0, reconnectEvery = 0.0;
+	std::uint32_t users = 1000, linesPerFrame = 16;
+	std::vector<std::string> commands;
+};
+
+template <typename T>
+auto parse_number(const std::string_view str) -> std::optional<T> {
+	T value{};
+	if (std::from_chars(str.data(), str.data() + str.size(), value).ec != std::errc())
+		return std::nullopt;
+	return value;
+}
+
+auto parse_options(const int argc, char **argv) -> std::optional<MockOptions> {
+	MockOptions opts;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		const auto arg = std::string_view(argv[i]);
+		const auto value = std::string_view(argv[i + 1]);
+		bool ok = true;
+		const auto set = [&ok]<typename T>(T &target, const std::optional<T> parsed) {
+			if (parsed) target = *parsed;
+			else ok = false;
+		};
+
+		if (arg == "--port") set(opts.port, parse_number<int>(value));
+		else if (arg == "--threads") set(opts.threads, parse_number<int>(value));
+		else if (arg == "--rate") set(opts.rate, parse_number<double>(value));
+		else if (arg == "--users") set(opts.users, parse_number<std::uint32_t>(value));
+		else if (arg == "--command-ratio") set(opts.commandRatio, parse_number<double>(value));
+		else if (arg == "--command") opts.commands.emplace_back(value);
+		else if (arg == "--lines-per-frame")
+			set(opts.linesPerFrame, parse_number<std::uint32_t>(value));
+		else if (arg == "--ping-every") set(opts.pingEvery, parse_number<double>(value));
+		else if (arg == "--reconnect-every") set(opts.reconnectEvery, parse_number<double>(value));
+		else ok = false;
+
+		if (!ok) return std::nullopt;
+	}
+	if (argc % 2 == 0) return std::nullopt;
+
+	if (opts.commands.empty())
+		opts.commands = {"!cc hello there", "!cc <pitch=1.5> wow", "!cc <pos=1|0|0> left side",
+						 "!cc <sfx=reverb|echo> echo echo"};
+	opts.users = std::max<std::uint32_t>(opts.users, 1);
+	opts.linesPerFrame = std::max<std::uint32_t>(opts.linesPerFrame, 1);
+	opts.commandRatio = std::clamp(opts.commandRatio, 0.0, 1.0);
+	return opts;
+}
+
+// Connected client, traffic is only sent once it has joined a channel
+struct MockClient {
+	WebSocketChannelPtr channel;
+	std::string nick, joinedChannel;
+};
+
+class MockServer {
+	MockOptions m_opts;
+	std::mutex m_clientsMutex;
+	std::unordered_map<hv::WebSocketChannel *, MockClient> m_clients;
+	std::atomic<std::uint64_t> m_sentMessages = 0, m_sentFrames = 0, m_connections = 0;
+
+public:
+	explicit MockServer(MockOptions opts) : m_opts(std::move(opts)) {}
+
+	void on_open(const WebSocketChannelPtr &channel) {
+		std::scoped_lock lock(m_clientsMutex);
+		m_clients[channel.get()] = MockClient{channel, "", ""};
+		++m_connections;
+	}
+
+	void on_close(const WebSocketChannelPtr &channel) {
+		std::scoped_lock lock(m_clientsMutex);
+		m_clients.erase(channel.get());
+	}
+
+	// Handles handshake lines sent by the client
+	void on_message(const WebSocketChannelPtr &channel, const std::string &frame) {
+		auto remaining = std::string_view(frame);
+		while (!remaining.empty()) {
+			const auto ircMsg = parse_irc_line(next_irc_line(remaining));
+			if (!ircMsg) continue;
+
+			switch (ircMsg->command) {
+			case IRCCommand::eNick: {
+				const auto nick = std::string(ircMsg->params);
+				set_client(channel, [&nick](MockClient &client) { client.nick = nick; });
+				channel->send(std::format(":tmi.twitch.tv 001 {0} :Welcome, GLHF!\r\n"
+										  ":tmi.twitch.tv 376 {0} :>\r\n",
+										  nick));
+				break;
+			}
+			case IRCCommand::eJoin: {
+				const auto joined = std::string(ircMsg->params);
+				std::string nick;
+				set_client(channel, [&](MockClient &client) {
+					client.joinedChannel = joined;
+					nick = client.nick;
+				});
+				channel->send(std::format(":{0}!{0}@{0}.tmi.twitch.tv JOIN {1}\r\n", nick, joined));
+				break;
+			}
+			case IRCCommand::ePing:
+				channel->send(std::format(":tmi.twitch.tv PONG tmi.twitch.tv :{}\r\n",
+										  ircMsg->trailing));
+				break;
+			default:
+				// PASS is accepted whatever it is, PONG needs no answer
+				break;
+			}
+		}
+	}
+
+	// Generates traffic until stop is set, printing counters once per second
+	void run(const std::atomic<bool> &stop) {
+		std::mt19937_64 rng(std::random_device{}());
+		std::uniform_int_distribution<std::uint32_t> userDist(0, m_opts.users - 1);
+		std::uniform_int_distribution<std::size_t> commandDist(0, m_opts.commands.size() - 1);
+		std::bernoulli_distribution isCommand(m_opts.commandRatio);
+
+		const auto start = std::chrono::steady_clock::now();
+		auto lastPing = start, lastReconnect = start, lastReport = start;
+		std::uint64_t generated = 0, reportedMessages = 0;
+		std::string frame;
+
+		while (!stop) {
+			const auto now = std::chrono::steady_clock::now();
+			const auto elapsed = std::chrono::duration<double>(now - start).count();
+
+			// Send whatever is due at the configured rate, packing lines into frames like Twitch
+			const auto due = static_cast<std::uint64_t>(elapsed * m_opts.rate);
+			while (generated < due) {
+				frame.clear();
+				std::uint32_t lines = 0;
+				for (; lines < m_opts.linesPerFrame && generated < due; ++lines, ++generated) {
+					const auto user = userDist(rng);
+					const auto text = isCommand(rng)
+										  ? std::string_view(m_opts.commands[commandDist(rng)])
+										  : std::string_view("just chatting, nothing to see");
+					std::format_to(
+						std::back_inserter(frame),
+						"@badge-info=;badges=;color=#1E90FF;display-name=user{0};"
+						"id={1};tmi-sent-ts={2};user-id={0} "
+						":user{0}!user{0}@user{0}.tmi.twitch.tv PRIVMSG {{channel}} :{3}\r\n",
+						user, generated, static_cast<std::uint64_t>(elapsed * 1000.0), text);
+				}
+				broadcast(frame, lines);
+			}
+
+			if (m_opts.pingEvery > 0.0 &&
+				std::chrono::duration<double>(now - lastPing).count() >= m_opts.pingEvery) {
+				broadcast("PING :tmi.twitch.tv\r\n", 0);
+				lastPing = now;
+			}
+
+			// Twitch asks clients to reconnect before restarting, then drops them
+			if (m_opts.reconnectEvery > 0.0 &&
+				std::chrono::duration<double>(now - lastReconnect).count() >=
+					m_opts.reconnectEvery) {
+				broadcast(":tmi.twitch.tv RECONNECT\r\n", 0);
+				close_all();
+				lastReconnect = now;
+			}
+
+			if (now - lastReport >= std::chrono::seconds(1)) {
+				const auto sent = m_sentMessages.load();
+				std::println("clients {}, connections {}, sent {} msgs ({} msgs/s), {} frames",
+							 client_count(), m_connections.load(), sent, sent - reportedMessages,
+							 m_sentFrames.load());
+				reportedMessages = sent;
+				lastReport = now;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+private:
+	void set_client(const WebSocketChannelPtr &channel,
+					const std::function<void(MockClient &)> &fn) {
+		std::scoped_lock lock(m_clientsMutex);
+		if (const auto it = m_clients.find(channel.get()); it != m_clients.end()) fn(it->second);
+	}
+
+	auto client_count() -> std::size_t {
+		std::scoped_lock lock(m_clientsMutex);
+		return m_clients.size();
+	}
+
+	// Sends frame to every client that has joined, "{channel}" is replaced with their channel
+	void broadcast(const std::string_view frame, const std::uint32_t lines) {
+		std::scoped_lock lock(m_clientsMutex);
+		for (const auto &client : m_clients | std::views::values) {
+			if (client.joinedChannel.empty()) continue;
+
+			std::string out;
+			out.reserve(frame.size() + lines * client.joinedChannel.size());
+			for (auto rest = frame; !rest.empty();) {
+				const auto pos = rest.find("{channel}");
+				out += rest.substr(0, pos);
+				if (pos == std::string_view::npos) break;
+				out += client.joinedChannel;
+				rest.remove_prefix(pos + std::string_view("{channel}").size());
+			}
+
+			client.channel->send(out);
+			m_sentMessages += lines;
+			++m_sentFrames;
+		}
+	}
+
+	void close_all() {
+		std::scoped_lock lock(m_clientsMutex);
+		for (const auto &client : m_clients | std::views::values) client.channel->close();
+	}
+};
+
+std::atomic<bool> stop_requested = false;
+
+auto main(int argc, char **argv) -> int {
+	const auto opts = parse_options(argc, argv);
+	if (!opts) {
+		std::println("Usage: {} [--port N] [--rate msgs/s] [--users N] [--command-ratio 0..1] "
+					 "[--command \"!cc text\"]... [--lines-per-frame N] [--ping-every s] "
+					 "[--reconnect-every s] [--threads N]",
+					 argv[0]);
+		return 1;
+	}
+
+	MockServer mock(*opts);
+
+	hv::WebSocketService service;
+	service.onopen = [&mock](const WebSocketChannelPtr &channel, const HttpRequestPtr &) {
+		mock.on_open(channel);
+	};
+	service.onmessage = [&mock](const WebSocketChannelPtr &channel, const std::string &msg) {
+		mock.on_message(channel, msg);
+	};
+	service.onclose = [&mock](const WebSocketChannelPtr &channel) { mock.on_close(channel); };
+
+	hv::WebSocketServer server(&service);
+	server.setPort(opts->port);
+	server.setThreadNum(opts->threads);
+	if (server.start() != 0) {
+		std::println("Failed to listen on port {}", opts->port);
+		return 2;
+	}
+
+	std::println("Mock Twitch IRC listening on ws://127.0.0.1:{}, {} msgs/s from {} users",
+				 opts->port, opts->rate, opts->users);
+	std::signal(SIGINT, [](int) { stop_requested = true; });
+	mock.run(stop_requested);
+
+	server.stop();
+	return 0;
+}
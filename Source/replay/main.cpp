@@ -0,0 +1,169 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+#include <standard.hpp>
+#endif
+
+import standard;
+import types;
+import config;
+import common;
+import assets;
+import audio;
+import twitch;
+import commands;
+import filesystem;
+import capture;
+import coalesce;
+import rng;
+
+// Replays a capture made with TwitchChatConnector::start_capture through the chat pipeline
+// usage: replay <capture file> [--speed N] [--root dir] [--mute] [--seed N]
+// speed of 1 keeps original timing, 0 feeds frames as fast as possible
+// seed makes random choices repeat between runs
+
+void print_error(const Result &res) {
+	if (!res) std::println("Error: {}", res.error().describe());
+}
+
+struct ReplayOptions {
+	std::filesystem::path capturePath, rootPath = ".";
+	double speed = 1.0;
+	bool mute = false;
+	std::uint64_t seed = 0;
+};
+
+auto parse_options(const int argc, char **argv) -> std::optional<ReplayOptions> {
+	ReplayOptions opts;
+	for (int i = 1; i < argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+		if (arg == "--speed" && i + 1 < argc) {
+			const auto value = std::string_view(argv[++i]);
+			if (std::from_chars(value.data(), value.data() + value.size(), opts.speed).ec !=
+					std::errc() ||
+				opts.speed < 0.0)
+				return std::nullopt;
+		} else if (arg == "--seed" && i + 1 < argc) {
+			const auto value = std::string_view(argv[++i]);
+			if (std::from_chars(value.data(), value.data() + value.size(), opts.seed).ec !=
+				std::errc())
+				return std::nullopt;
+		} else if (arg == "--root" && i + 1 < argc)
+			opts.rootPath = argv[++i];
+		else if (arg == "--mute")
+			opts.mute = true;
+		else if (opts.capturePath.empty() && !arg.starts_with("--"))
+			opts.capturePath = arg;
+		else
+			return std::nullopt;
+	}
+	if (opts.capturePath.empty()) return std::nullopt;
+	return opts;
+}
+
+auto main(int argc, char **argv) -> int {
+	const auto opts = parse_options(argc, argv);
+	if (!opts) {
+		std::println("Usage: {} <capture file> [--speed N] [--root dir] [--mute] [--seed N]",
+					 argv[0]);
+		return 1;
+	}
+	if (opts->seed != 0) RandomHandler::set_seed(opts->seed);
+
+	CaptureReader reader;
+	if (const auto res = reader.open(opts->capturePath); !res) {
+		print_error(res);
+		return std::to_underlying(res.error().code);
+	}
+
+	auto rootPath = opts->rootPath.string();
+	std::array rootArgv = {rootPath.data()};
+	if (const auto res = Filesystem::initialize(1, rootArgv.data()); !res) {
+		print_error(res);
+		return std::to_underlying(res.error().code);
+	}
+	// Continue despite error, defaults are fine for replaying
+	print_error(global_config.load());
+
+	if (const auto res = AssetsHandler::initialize(); !res) {
+		print_error(res);
+		return std::to_underlying(res.error().code);
+	}
+	if (const auto res = AudioPlayer::initialize(); !res) {
+		print_error(res);
+		return std::to_underlying(res.error().code);
+	}
+	if (opts->mute) AudioPlayer::set_global_volume(0.0f);
+
+	// Notifications are only counted, there is no GUI to show them in
+	std::atomic<std::uint64_t> notifications = 0, dispatched = 0;
+	if (const auto res = CommandHandler::initialize(
+			[&notifications](const std::string &, const TwitchChatMessage &,
+							 const std::shared_ptr<const AsciiArt> &) { ++notifications; });
+		!res) {
+		print_error(res);
+		return std::to_underlying(res.error().code);
+	}
+
+	const auto onMessage = [&dispatched](const TwitchChatMessage &msg) {
+		++dispatched;
+		CommandHandler::dispatch_message(msg);
+	};
+	if (const auto res = TwitchChatConnector::initialize(onMessage); !res) {
+		print_error(res);
+		return std::to_underlying(res.error().code);
+	}
+
+	std::uint64_t frames = 0, bytes = 0;
+	const auto start = std::chrono::steady_clock::now();
+	while (const auto frame = reader.next()) {
+		if (opts->speed > 0.0) {
+			const auto due = start + std::chrono::duration_cast<std::chrono::nanoseconds>(
+										 frame->offset / opts->speed);
+			// Keep audio going while waiting for the frame to be due
+			while (std::chrono::steady_clock::now() < due) {
+				AudioPlayer::update();
+				std::this_thread::sleep_until(
+					std::min(due, std::chrono::steady_clock::now() + std::chrono::milliseconds(5)));
+			}
+		}
+
+		if (const auto res = TwitchChatConnector::feed_frame(frame->data); !res) print_error(res);
+		++frames;
+		bytes += frame->data.size();
+	}
+	const auto fed = std::chrono::steady_clock::now();
+
+	// Stats must be taken before cleanup, which drains and releases the queue
+	const auto queueStats = TwitchChatConnector::get_queue_stats();
+	const auto userStats = TwitchChatConnector::get_user_table_stats();
+	TwitchChatConnector::cleanup();
+	const auto drained = std::chrono::steady_clock::now();
+
+	const auto seconds = [](const auto duration) {
+		return std::chrono::duration<double>(duration).count();
+	};
+	const auto total = std::max(seconds(drained - start), 1e-9);
+	std::println("Replayed {} frames ({} bytes) in {:.3f}s, ingest {:.3f}s", frames, bytes, total,
+				 seconds(fed - start));
+	std::println("Throughput: {:.1f} frames/s, {:.2f} MiB/s", frames / total,
+				 bytes / total / (1024.0 * 1024.0));
+	std::println("Queue: enqueued {}, dropped {}, high water {}/{}", queueStats.enqueued,
+				 queueStats.dropped, queueStats.highWater, queueStats.capacity);
+	std::println("Dispatched {} messages, launched {} notifications, {} users seen",
+				 dispatched.load(), notifications.load(), userStats.size);
+	std::println("Coalesced {} duplicate commands", CommandCoalescer::get_stats().absorbed);
+	const auto soundStats = AudioPlayer::get_admission_stats();
+	std::println("Sound sources: admitted {}, queued {}, shed {}", soundStats.admitted,
+				 soundStats.queued, soundStats.shed);
+	const auto poolStats = AudioPlayer::get_source_pool_stats();
+	std::println("Source pool: {} sources, high water {}, stolen {}, exhausted {}",
+				 poolStats.size, poolStats.highWater, poolStats.stolen, poolStats.exhausted);
+	const auto bankStats = AudioPlayer::get_sound_bank_stats();
+	std::println("Sound bank: {} sounds ({} bytes), hits {}, misses {}, evictions {}",
+				 bankStats.sounds, bankStats.bytes, bankStats.hits, bankStats.misses,
+				 bankStats.evictions);
+
+	CommandHandler::cleanup();
+	AudioPlayer::cleanup();
+	AssetsHandler::cleanup();
+	return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef CN_SUPPORTS_MODULES_STD
+#include <standard.hpp>
+#endif
+
+import standard;
+import config;
+import cooldown;
+
+// Checks that fixed cooldowns clear on time, however often the timing wheel is advanced
+// usage: test_cooldown, exits with 1 if any case fails
+
+// Clearing may lag expiry by up to one wheel tick
+constexpr std::int64_t wheel_resolution_ms = 100;
+
+// Starts a global cooldown at startMs, then admits every stepMs until it has cleared
+// @return time of the first admit after the one starting the cooldown
+auto first_admit_after(const std::int64_t startMs, const std::int64_t stepMs,
+					   const std::int64_t limitMs) -> std::optional<std::int64_t> {
+	CooldownHandler::initialize();
+	// Taken after initialize, so whole milliseconds from here land on the same ones inside
+	const auto base = std::chrono::steady_clock::now();
+	const auto at = [base](const std::int64_t ms) { return base + std::chrono::milliseconds(ms); };
+
+	CooldownState userState;
+	if (!CooldownHandler::admit(at(startMs), userState, 1, false, std::nullopt))
+		return std::nullopt;
+	for (auto nowMs = startMs + stepMs; nowMs <= limitMs; nowMs += stepMs)
+		if (CooldownHandler::admit(at(nowMs), userState, 1, false, std::nullopt)) return nowMs;
+	return std::nullopt;
+}
+
+auto main() -> int {
+	global_config.enabledCooldowns = CommandCooldownType::eGlobal;
+	global_config.cooldownMode = CooldownMode::eFixed;
+	global_config.cooldownGlobal.value = 5;
+	const std::int64_t cooldownMs = 5000;
+
+	auto failures = 0;
+	for (const std::int64_t startMs : {0, 99, 100, 1234, 50'050})
+		for (const std::int64_t stepMs : {1, 10, 37, 100, 250, 1000}) {
+			const auto expiryMs = startMs + cooldownMs;
+			const auto admitted = first_admit_after(startMs, stepMs, expiryMs + 200'000);
+			// First step at or past expiry, plus at most one tick of wheel resolution
+			if (admitted && *admitted >= expiryMs - 1 &&
+				*admitted < expiryMs + wheel_resolution_ms + stepMs)
+				continue;
+
+			++failures;
+			std::println("FAIL start {}ms step {}ms: expected clear at {}ms, got {}", startMs,
+						 stepMs, expiryMs,
+						 admitted ? std::format("{}ms", *admitted) : std::string("never"));
+		}
+
+	if (failures > 0) return 1;
+	std::println("All cooldown cases passed");
+	return 0;
+}
@@ -7,17 +7,33 @@ add_requires("libogg", "libvorbis", "libopus", "libflac", "libsndfile", "openal-
 includes("napi.lua")
 add_requires("napi 8.1.0", { configs = { napi_version = 7 } })
 
-target("chatnotifier")
-    set_kind("shared")
+-- Core sources and packages, shared by the node module and the tools
+function add_chatnotifier_core()
     add_files("Source/libchatnotifier/glad/*.c")
     add_files("Source/libchatnotifier/imgui/*.cpp")
-    add_files("Source/libchatnotifier/*.cppm")
-    add_files("Source/libchatnotifier/napi.cppm", {public = true})
-    add_files("Source/libchatnotifier/node/*.cc", {public = true})
+    add_files("Source/libchatnotifier/*.cppm|napi.cppm")
     add_includedirs("Source/libchatnotifier")
     add_packages("libogg", "libvorbis", "libopus", "libflac", "libsndfile", "openal-soft",
-                 "imgui", "glfw", "libhv", "python", "pybind11", "node-api-headers", "napi")
+                 "imgui", "glfw", "libhv", "python", "pybind11")
     add_defines("TWITCH_CLIENT_SECRET=\"$(env TWITCH_CLIENT_SECRET)\"")
+end
+
+-- Message types and the modules they need, for tools that only parse chat
+function add_chatnotifier_types()
+    for _, name in ipairs({"standard", "rng", "common", "filesystem", "queue", "admission",
+                           "config", "latency", "coalesce", "grammar", "types"}) do
+        add_files("Source/libchatnotifier/" .. name .. ".cppm")
+    end
+    add_includedirs("Source/libchatnotifier")
+    add_packages("libhv")
+end
+
+target("chatnotifier")
+    set_kind("shared")
+    add_chatnotifier_core()
+    add_files("Source/libchatnotifier/napi.cppm", {public = true})
+    add_files("Source/libchatnotifier/node/*.cc", {public = true})
+    add_packages("node-api-headers", "napi")
     add_linkdirs("External/node/lib")
     add_links("node")
     if is_plat("windows") then
@@ -28,3 +44,45 @@ target("chatnotifier")
     after_build(function(target)
         os.cp("$(buildir)/$(host)/$(arch)/$(mode)/chatnotifier.dll", "$(buildir)/$(host)/$(arch)/$(mode)/chatnotifier.node")
     end)
+
+-- Replays captured chat traffic through the pipeline, "xmake build replay"
+target("replay")
+    set_kind("binary")
+    set_default(false)
+    add_chatnotifier_core()
+    add_files("Source/replay/main.cpp")
+
+-- Stand-in Twitch IRC WebSocket server for load testing, "xmake build mockirc"
+target("mockirc")
+    set_kind("binary")
+    set_default(false)
+    add_files("Source/libchatnotifier/standard.cppm", "Source/libchatnotifier/irc.cppm")
+    add_files("Source/mockirc/main.cpp")
+    add_includedirs("Source/libchatnotifier")
+    add_packages("libhv")
+
+-- Parsing microbenchmark, reports ns/msg and allocations/msg, "xmake build bench_parse"
+target("bench_parse")
+    set_kind("binary")
+    set_default(false)
+    add_chatnotifier_types()
+    add_files("Source/libchatnotifier/utf8.cppm")
+    add_files("Source/bench_parse/main.cpp")
+
+-- Checks cooldowns clear on time, "xmake build test_cooldown && xmake run test_cooldown"
+target("test_cooldown")
+    set_kind("binary")
+    set_default(false)
+    add_chatnotifier_types()
+    add_files("Source/libchatnotifier/cooldown.cppm")
+    add_files("Source/test_cooldown/main.cpp")
+
+-- libFuzzer target for the parser, needs clang, "xmake f --toolchain=clang && xmake build fuzz_parse"
+target("fuzz_parse")
+    set_kind("binary")
+    set_default(false)
+    set_symbols("debug")
+    add_chatnotifier_types()
+    add_files("Source/fuzz_parse/main.cpp")
+    add_cxflags("-fsanitize=fuzzer,address,undefined", {force = true})
+    add_ldflags("-fsanitize=fuzzer,address,undefined", {force = true})